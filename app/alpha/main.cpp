@@ -1119,6 +1119,21 @@ void prepare_named_memory_regions(const Proj_cfg_t* proj_cfg)
 			panic("Could not set memory attribs.");
 		}
 
+		// special region 'ramfs' gets copy of ramfs, it allows apps to read ELFs, e.g. for symbols
+		if (!strcmp(mem->name, "ramfs"))
+		{
+			addr_t ramfs_addr = 0;
+			size_t ramfs_sz = 0;
+			rc = wrm_ramfs_area(&ramfs_addr, &ramfs_sz);
+			if (rc  ||  ramfs_sz > mem->sz)
+			{
+				wrm_loge("Could not copy ramfs, rc=%d, ramfs sz=0x%zx, mem sz=0x%zx.\n",
+					rc, ramfs_sz, mem->sz);
+				panic("Wrong config for named memory.");
+			}
+			memcpy((void*)location.addr(), (void*)ramfs_addr, ramfs_sz);
+		}
+
 		bool added = named_memory.add(mem, location);
 		if (!added)
 			panic("Could not add location to named memory.");
@@ -1252,7 +1267,7 @@ static void process_pfault(L4_msgtag_t tag, word_t* mr, L4_thrid_t from)
 
 	// find local address for fault address
 	L4_fpage_t local_fpage;
-	int rc = wrm_app_get_location(from, addr, sizeof(word_t), acc, &local_fpage);
+	int rc = wrm_app_get_pfault_location(from, addr, acc, &local_fpage);
 	if (rc == -2) // location not found
 	{
 		//wrm_logd("pager could not resolve pfault:  thr=%u, va=0x%lx, acc=%d, inst=0x%lx.\n",
@@ -1261,7 +1276,7 @@ static void process_pfault(L4_msgtag_t tag, word_t* mr, L4_thrid_t from)
 	}
 	else if (rc)
 	{
-		wrm_loge("wrm_app_get_location(addr=0x%lx, acc=%d) - rc=%d, thr=%u, inst=0x%lx.\n",
+		wrm_loge("wrm_app_get_pfault_location(addr=0x%lx, acc=%d) - rc=%d, thr=%u, inst=0x%lx.\n",
 			addr, acc, rc, from.number(), inst);
 		l4_kdb("unexpected error, roottask internal error");
 	}
@@ -2297,6 +2312,45 @@ void process_app_threads_request(L4_msgtag_t tag, word_t* mr, L4_thrid_t from)
 		l4_kdb("Sending grant/map item is failed");
 	}
 }
+enum { Kprof_samples_max = 4096 };  // no more than kprof app reads
+static L4_kprof_sample_t kprof_samples[Kprof_samples_max];
+
+// kdb kprof syscall is allowed for roottask only, do it for app
+void process_kprof_request(L4_msgtag_t tag, word_t* mr, L4_thrid_t from)
+{
+	assert(tag.untyped() == 2);
+	assert(tag.typed() == 0);
+
+	word_t op = mr[1];
+	size_t cnt = mr[2] < Kprof_samples_max ? mr[2] : Kprof_samples_max;
+	int res = -1;
+	if (op == L4_kprof_start  ||  op == L4_kprof_stop)
+	{
+		l4_kdb(L4_kdb_kprof, op);
+		res = 0;
+	}
+	else if (op == L4_kprof_read)
+	{
+		res = l4_kdb(L4_kdb_kprof, op, kprof_samples, cnt * sizeof(L4_kprof_sample_t));
+	}
+
+	// send reply, samples are sent as string
+	bool str = op == L4_kprof_read  &&  res > 0;
+	tag.set_ipc(Wrm_ipc_kprof, 1, str ? 2 : 0);
+	L4_utcb_t* utcb = l4_utcb();
+	utcb->mr[0] = tag.raw();
+	utcb->mr[1] = res;
+	if (str)
+	{
+		L4_string_item_t sitem = L4_string_item_t::create_simple((word_t)kprof_samples,
+			res * sizeof(L4_kprof_sample_t));
+		utcb->mr[2] = sitem.word0();
+		utcb->mr[3] = sitem.word1();
+	}
+	int rc = l4_send(from, L4_time_t::Never);
+	if (rc)
+		wrm_loge("l4_send(kprof) - rc=%u.\n", rc);
+}
 //--------------------------------------------------------------------------------------------------
 //  ~Requests handlers
 //--------------------------------------------------------------------------------------------------
@@ -2381,6 +2435,7 @@ int main()
 				case Wrm_ipc_register_thread:  process_register_thread_request(tag, mr, from); break;
 				case Wrm_ipc_get_thread_id:    process_get_thread_id_request(tag, mr, from);   break;
 				case Wrm_ipc_app_threads:      process_app_threads_request(tag, mr, from);     break;
+				case Wrm_ipc_kprof:            process_kprof_request(tag, mr, from);           break;
 				default:
 					wrm_loge("rx:  from=%u, label=%ld, u=%u, t=%u.\n", from.number(), tag.ipc_label(), tag.untyped(), tag.typed());
 					l4_kdb("Alpha received unexpected msg - IMPLEMENT ME");
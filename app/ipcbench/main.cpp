@@ -0,0 +1,157 @@
+//##################################################################################################
+//
+//  ipcbench - ping-pong IPC round trip latency for different message sizes.
+//
+//  Messages up to Kcfg::Fast_ipc_words untyped words go through kernel IPC fast path,
+//  longer messages go through generic path. To compare the same sizes with generic path
+//  build kernel with usr_krn_fastipc=0.
+//
+//  On x86 every size is measured with sysenter/syscall entry and with int 0x80 entry, both
+//  threads share the selected entry. Kernel built with usr_krn_fastscall=0 has only int 0x80.
+//
+//  Usage (alph args):
+//    ipcbench [rounds]
+//
+//##################################################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "l4_api.h"
+#include "sys_proc.h"
+#include "wrmos.h"
+
+enum
+{
+	Label = 0x123,  // any label not used by kernel extentions
+	Words_max = 16
+};
+
+static L4_thrid_t server_id;
+
+// cycles are readable from user mode for x86 and for arm PMU (not arm11), kernel allows it
+#if defined(Cfg_arch_x86)  ||  defined(Cfg_arch_x86_64)  ||  (defined(Cfg_arch_arm)  &&  !defined(Cfg_cpu_arm11))
+# define HAS_USER_CYCLES 1
+#else
+# define HAS_USER_CYCLES 0
+#endif
+
+static inline uint64_t user_cycles()
+{
+	#if HAS_USER_CYCLES
+	return Proc::cycles();
+	#else
+	return 0;
+	#endif
+}
+
+static inline uint64_t user_cycles_since(uint64_t start)
+{
+	#if defined(Cfg_arch_arm)
+	return (uint32_t)(user_cycles() - start);  // 32-bit counter
+	#else
+	return user_cycles() - start;
+	#endif
+}
+
+static L4_thrid_t create_thread(L4_thread_func_t func, unsigned prio, const char* name)
+{
+	L4_fpage_t stack_fp = wrm_pgpool_alloc(Cfg_page_sz);
+	L4_fpage_t utcb_fp = wrm_pgpool_alloc(Cfg_page_sz);
+	assert(!stack_fp.is_nil());
+	assert(!utcb_fp.is_nil());
+	L4_thrid_t id = L4_thrid_t::Nil;
+	int rc = wrm_thr_create(utcb_fp, func, 0, stack_fp.addr(), stack_fp.size(), prio,
+	                        name, Wrm_thr_flag_no, &id);
+	if (rc)
+	{
+		wrm_loge("wrm_thr_create() - rc=%d.\n", rc);
+		return L4_thrid_t::Nil;
+	}
+	return id;
+}
+
+// echo server:  reply with the same number of words and open wait
+static long server_thread(long unused)
+{
+	(void) unused;
+	L4_utcb_t* utcb = l4_utcb();
+	L4_thrid_t from = L4_thrid_t::Nil;
+	int rc = l4_receive(L4_thrid_t::Any, L4_time_t::Never, &from);
+	while (!rc)
+	{
+		L4_msgtag_t tag;
+		tag.set_ipc(Label, utcb->msgtag().untyped(), 0);
+		utcb->msgtag(tag);
+		rc = l4_ipc(from, L4_thrid_t::Any, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never), &from);
+	}
+	wrm_loge("server:  l4_ipc() - rc=%d.\n", rc);
+	return -1;
+}
+
+static int measure(unsigned words, unsigned rounds, const char* entry)
+{
+	L4_utcb_t* utcb = l4_utcb();
+	for (unsigned i=1; i<=words; ++i)
+		utcb->mr[i] = i;
+
+	L4_clock_t start = l4_system_clock();
+	uint64_t start_cycles = user_cycles();
+	for (unsigned i=0; i<rounds; ++i)
+	{
+		L4_msgtag_t tag;
+		tag.set_ipc(Label, words, 0);
+		utcb->msgtag(tag);
+		int rc = l4_ipc(server_id, server_id, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never));
+		if (rc)
+		{
+			wrm_loge("client:  l4_ipc() - rc=%d.\n", rc);
+			return -1;
+		}
+	}
+	uint64_t cycles = user_cycles_since(start_cycles);
+	L4_clock_t spent = l4_system_clock() - start;
+
+	#if HAS_USER_CYCLES
+	wrm_logi("words=%2u, entry=%s:  %u round trips for %llu usec, %llu nsec, %llu cycles per round trip.\n",
+		words, entry, rounds, (unsigned long long)spent,
+		(unsigned long long)spent * 1000 / rounds, (unsigned long long)cycles / rounds);
+	#else
+	(void) cycles;
+	wrm_logi("words=%2u, entry=%s:  %u round trips for %llu usec, %llu nsec per round trip.\n",
+		words, entry, rounds, (unsigned long long)spent, (unsigned long long)spent * 1000 / rounds);
+	#endif
+	return 0;
+}
+
+int main(int argc, const char* argv[])
+{
+	unsigned rounds = argc>=2 ? strtoul(argv[1], 0, 10) : 0;
+	if (!rounds)
+		rounds = 10000;
+
+	server_id = create_thread(server_thread, 100, "ib-s");
+	if (server_id.is_nil())
+		return -1;
+
+	static const unsigned sizes[] = { 0, 1, 4, 8, 9, Words_max };
+	for (unsigned pass=0; ; ++pass)
+	{
+		wrm_logi("pass %u:\n", pass);
+		for (unsigned i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i)
+		{
+			bool fast = l4_kip()->fast_scall;
+			l4_fast_syscall(true);
+			if (measure(sizes[i], rounds, fast ? "fast" : "trap"))
+				return -2;
+			if (fast)
+			{
+				l4_fast_syscall(false);
+				if (measure(sizes[i], rounds, "trap"))
+					return -2;
+			}
+		}
+	}
+	return 0;
+}
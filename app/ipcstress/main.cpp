@@ -0,0 +1,243 @@
+//##################################################################################################
+//
+//  ipcstress - open-wait receive latency while many threads are blocked in send phase.
+//
+//  Clock mode checks system clock while many threads sleep with short timeouts, in tickless
+//  kernel every timeout reprograms timer. Clock must be monotonic and its rate against cycle
+//  counter must be the same as in quiet system (x86 only, other archs check monotonicity).
+//
+//  Usage (alph args):
+//    ipcstress server [rounds]  - measure ping-pong with open receive (from_spec=any)
+//    ipcstress noise  [clients] - create clients blocked forever by send to main thread
+//    ipcstress clock  [secs]    - compare quiet and stress phases of 'secs' each
+//
+//##################################################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "l4_api.h"
+#include "sys_proc.h"
+#include "wrmos.h"
+
+// cycle counter is used as reference clock, it is readable from user mode and 64-bit on x86
+#if defined(Cfg_arch_x86)  ||  defined(Cfg_arch_x86_64)
+# define HAS_REF_CLOCK 1
+#else
+# define HAS_REF_CLOCK 0
+#endif
+
+enum
+{
+	Sleepers        = 8,     // threads to sleep with short timeouts
+	Sleep_usec      = 150,   // timeout of first sleeper, others are a bit longer
+	Quiet_usec      = 100 * 1000,
+	Drift_ppm_max   = 1000   // allowed difference of clock rate in stress and quiet phases
+};
+
+static L4_thrid_t server_id;  // ping-pong partner for client
+static L4_thrid_t sink_id;    // destination of noise clients, never receives
+static volatile bool stress_on;  // sleepers use short timeouts
+
+static L4_thrid_t create_thread(L4_thread_func_t func, unsigned prio, const char* name, long arg = 0)
+{
+	L4_fpage_t stack_fp = wrm_pgpool_alloc(Cfg_page_sz);
+	L4_fpage_t utcb_fp = wrm_pgpool_alloc(Cfg_page_sz);
+	assert(!stack_fp.is_nil());
+	assert(!utcb_fp.is_nil());
+	L4_thrid_t id = L4_thrid_t::Nil;
+	int rc = wrm_thr_create(utcb_fp, func, arg, stack_fp.addr(), stack_fp.size(), prio,
+	                        name, Wrm_thr_flag_no, &id);
+	if (rc)
+	{
+		wrm_loge("wrm_thr_create() - rc=%d.\n", rc);
+		return L4_thrid_t::Nil;
+	}
+	return id;
+}
+
+// blocked in send phase forever
+static long noise_thread(long unused)
+{
+	(void) unused;
+	L4_utcb_t* utcb = l4_utcb();
+	utcb->msgtag(L4_msgtag_t());
+	int rc = l4_send(sink_id, L4_time_t::Never);
+	wrm_loge("noise:  l4_send() returns, rc=%d.\n", rc);
+	return 0;
+}
+
+// call server in loop
+static long client_thread(long unused)
+{
+	(void) unused;
+	L4_utcb_t* utcb = l4_utcb();
+	while (1)
+	{
+		utcb->msgtag(L4_msgtag_t());
+		int rc = l4_ipc(server_id, server_id, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never));
+		if (rc)
+		{
+			wrm_loge("client:  l4_ipc() - rc=%d.\n", rc);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int noise(unsigned clients)
+{
+	sink_id = l4_utcb()->global_id();
+	unsigned cnt = 0;
+	for (; cnt<clients; ++cnt)
+		if (create_thread(noise_thread, 50, "i-nz").is_nil())
+			break;
+	wrm_logi("noise:  %u clients are blocked by send to %u.\n", cnt, sink_id.number());
+
+	while (1)
+		sleep(1000);
+	return 0;
+}
+
+static int server(unsigned rounds)
+{
+	server_id = l4_utcb()->global_id();
+
+	// let noise apps block their clients
+	sleep(1);
+
+	L4_thrid_t client = create_thread(client_thread, 100, "i-cl");
+	if (client.is_nil())
+		return -1;
+
+	L4_utcb_t* utcb = l4_utcb();
+	L4_thrid_t from = L4_thrid_t::Nil;
+	int rc = l4_receive(L4_thrid_t::Any, L4_time_t::Never, &from);
+	if (rc)
+	{
+		wrm_loge("server:  l4_receive() - rc=%d.\n", rc);
+		return -2;
+	}
+
+	for (unsigned pass=0; ; ++pass)
+	{
+		L4_clock_t start = l4_system_clock();
+		for (unsigned i=0; i<rounds; ++i)
+		{
+			// reply and open wait
+			utcb->msgtag(L4_msgtag_t());
+			rc = l4_ipc(from, L4_thrid_t::Any, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never), &from);
+			if (rc)
+			{
+				wrm_loge("server:  l4_ipc() - rc=%d.\n", rc);
+				return -3;
+			}
+		}
+		L4_clock_t spent = l4_system_clock() - start;
+		wrm_logi("pass %u:  %u round trips for %llu usec, %llu nsec per round trip.\n",
+			pass, rounds, (unsigned long long)spent, (unsigned long long)spent * 1000 / rounds);
+	}
+	return 0;
+}
+
+// sleep in loop, every short timeout makes tickless kernel reprogram timer
+static long sleeper_thread(long num)
+{
+	while (1)
+		usleep(stress_on ? Sleep_usec + num * 37 : Quiet_usec);
+	return 0;
+}
+
+static inline uint64_t ref_clock()
+{
+	#if HAS_REF_CLOCK
+	return Proc::cycles();
+	#else
+	return 0;
+	#endif
+}
+
+// sleep and read clock during 'secs', return clock and reference clock spent
+static int clock_phase(unsigned secs, uint64_t* usec, uint64_t* ref)
+{
+	L4_clock_t start = l4_system_clock();
+	uint64_t ref_start = ref_clock();
+	L4_clock_t prev = start;
+	while (prev - start < secs * 1000000ull)
+	{
+		usleep(1000);
+		L4_clock_t now = l4_system_clock();
+		if (now < prev)
+		{
+			wrm_loge("clock:  clock goes back:  prev=%llu, now=%llu.\n",
+				(unsigned long long)prev, (unsigned long long)now);
+			return -1;
+		}
+		prev = now;
+	}
+	*usec = prev - start;
+	*ref = ref_clock() - ref_start;
+	return 0;
+}
+
+static int clock_check(unsigned secs)
+{
+	unsigned cnt = 0;
+	for (; cnt<Sleepers; ++cnt)
+		if (create_thread(sleeper_thread, 100, "i-sl", cnt).is_nil())
+			return -1;
+
+	for (unsigned pass=0; ; ++pass)
+	{
+		uint64_t quiet_usec = 0;
+		uint64_t quiet_ref = 0;
+		uint64_t stress_usec = 0;
+		uint64_t stress_ref = 0;
+
+		stress_on = false;
+		if (clock_phase(secs, &quiet_usec, &quiet_ref))
+			return -2;
+		stress_on = true;
+		if (clock_phase(secs, &stress_usec, &stress_ref))
+			return -3;
+
+		if (!HAS_REF_CLOCK  ||  !quiet_ref  ||  !stress_ref)
+		{
+			wrm_logi("pass %u:  clock is monotonic, no reference clock to check drift.\n", pass);
+			continue;
+		}
+
+		// rate difference:  stress_usec/stress_ref against quiet_usec/quiet_ref
+		int64_t diff = (int64_t)(stress_usec * quiet_ref - quiet_usec * stress_ref);
+		int64_t ppm = diff / (int64_t)(quiet_usec * stress_ref / 1000000);
+		wrm_logi("pass %u:  quiet %llu usec, stress %llu usec, drift %lld ppm.\n", pass,
+			(unsigned long long)quiet_usec, (unsigned long long)stress_usec, (long long)ppm);
+		if (ppm > Drift_ppm_max  ||  ppm < -Drift_ppm_max)
+		{
+			wrm_loge("clock:  drift %lld ppm is more than %d ppm.\n", (long long)ppm, Drift_ppm_max);
+			return -4;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, const char* argv[])
+{
+	const char* mode = argc>=2 ? argv[1] : "";
+	unsigned num = argc>=3 ? strtoul(argv[2], 0, 10) : 0;
+
+	if (!strcmp(mode, "server"))
+		return server(num ? num : 10000);
+
+	if (!strcmp(mode, "noise"))
+		return noise(num);
+
+	if (!strcmp(mode, "clock"))
+		return clock_check(num ? num : 5);
+
+	wrm_loge("usage:  ipcstress <server [rounds] | noise [clients] | clock [secs]>.\n");
+	return -1;
+}
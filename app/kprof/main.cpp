@@ -0,0 +1,237 @@
+//##################################################################################################
+//
+//  kprof - statistical profiler, prints the hottest functions of all apps.
+//
+//  Kernel takes sample of interrupted thread on every timer tick, see krn/kprof.h. The app
+//  periodically starts sampling, reads samples and resolves user pc to function symbols of ELF
+//  files from ramfs. Thread number selects ELF:  sigma0.elf, roottask.elf and then apps in order
+//  of config.alph. Kernel samples are idle samples because kernel runs with disabled irqs.
+//  Kernel allows profiler control to roottask only, app does it by requests to alpha.
+//
+//  App reads ramfs via named memory 'ramfs' that alpha fills by copy of ramfs, so project config
+//  should have memory 'ramfs' with size Ramfs_sz and app should list it in 'memory:'.
+//
+//  Usage (alph args):
+//    kprof [seconds] [top]
+//
+//##################################################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "l4_api.h"
+#include "wrmos.h"
+#include "elfloader.h"
+
+enum
+{
+	Ramfs_sz    = 0x400000,  // size of named memory 'ramfs' in alph
+	Samples_max = 4096,      // kernel copies no more than usr_krn_kprof samples
+	Elfs_max    = 10,        // sigma0, roottask and apps
+	Funcs_max   = 256
+};
+
+struct Elf_t
+{
+	unsigned    first_thr;  // thread numbers of task
+	unsigned    end_thr;    //
+	char        file[32];   // file name in ramfs
+	const void* addr;       //
+	size_t      sz;         //
+};
+
+struct Func_t
+{
+	const Elf_t* elf;       // 0 for kernel and unknown threads
+	const char*  name;      // symbol name inside ELF, 0 if not found
+	unsigned     cnt;
+};
+
+static Elf_t elfs[Elfs_max];
+static unsigned elfs_cnt;
+static L4_kprof_sample_t samples[Samples_max];
+static Func_t funcs[Funcs_max];
+static unsigned others;  // samples that don't fit to funcs
+
+static void add_elf(unsigned first_thr, unsigned threads, const char* file, unsigned len)
+{
+	if (elfs_cnt == Elfs_max)
+		return;
+	Elf_t& e = elfs[elfs_cnt];
+	e.first_thr = first_thr;
+	e.end_thr = first_thr + threads;
+	snprintf(e.file, sizeof(e.file), "%.*s", len, file);
+	addr_t addr = 0;
+	int rc = wrm_ramfs_get_file(e.file, &addr, &e.sz);
+	if (rc)
+		wrm_logw("no file '%s' in ramfs, rc=%d.\n", e.file, rc);
+	e.addr = rc ? 0 : (const void*)addr;
+	elfs_cnt++;
+}
+
+// take file_path and threads_max of every app from config.alph
+static int parse_config()
+{
+	addr_t cfg_addr = 0;
+	size_t cfg_sz = 0;
+	int rc = wrm_ramfs_get_file("config.alph", &cfg_addr, &cfg_sz);
+	if (rc)
+	{
+		wrm_loge("wrm_ramfs_get_file(config.alph) - rc=%d.\n", rc);
+		return -1;
+	}
+
+	const char* cfg = (const char*)cfg_addr;
+	const char* end = cfg + cfg_sz;
+	unsigned thr = l4_kip()->thread_info.user_base();
+	add_elf(thr++, 1, "sigma0.elf", 10);
+	add_elf(thr++, 1, "roottask.elf", 12);
+
+	const char* file = 0;
+	unsigned file_len = 0;
+	for (const char* line=cfg; line<end; )
+	{
+		const char* eol = (const char*)memchr(line, '\n', end - line);
+		if (!eol)
+			eol = end;
+
+		const char* val = line;
+		while (val < eol  &&  (*val == ' '  ||  *val == '\t'))
+			val++;
+		if (!strncmp(val, "file_path:", 10))
+		{
+			val += 10;
+			while (val < eol  &&  (*val == ' '  ||  *val == '\t'))
+				val++;
+			if (!strncmp(val, "ramfs:/", 7))
+			{
+				file = val + 7;
+				file_len = 0;
+				while (file + file_len < eol  &&  file[file_len] > ' ')
+					file_len++;
+			}
+		}
+		else if (!strncmp(val, "threads_max:", 12)  &&  file)
+		{
+			unsigned threads = strtoul(val + 12, 0, 0);
+			add_elf(thr, threads, file, file_len);
+			thr += threads;
+			file = 0;
+		}
+		line = eol + 1;
+	}
+	return 0;
+}
+
+static const Elf_t* find_elf(unsigned thr)
+{
+	for (unsigned i=0; i<elfs_cnt; ++i)
+		if (thr >= elfs[i].first_thr  &&  thr < elfs[i].end_thr)
+			return &elfs[i];
+	return 0;
+}
+
+// count sample for function, names are pointers into ELF so compare pointers
+static unsigned add_sample(unsigned funcs_cnt, const Elf_t* elf, const char* name)
+{
+	for (unsigned i=0; i<funcs_cnt; ++i)
+	{
+		if (funcs[i].elf == elf  &&  funcs[i].name == name)
+		{
+			funcs[i].cnt++;
+			return funcs_cnt;
+		}
+	}
+	if (funcs_cnt == Funcs_max)
+	{
+		others++;
+		return funcs_cnt;
+	}
+	funcs[funcs_cnt].elf = elf;
+	funcs[funcs_cnt].name = name;
+	funcs[funcs_cnt].cnt = 1;
+	return funcs_cnt + 1;
+}
+
+static void report(unsigned cnt, unsigned top)
+{
+	unsigned funcs_cnt = 0;
+	unsigned idle = 0;
+	others = 0;
+	for (unsigned i=0; i<cnt; ++i)
+	{
+		const L4_kprof_sample_t& s = samples[i];
+		if (s.flags & L4_kprof_sample_t::Kernel)
+		{
+			idle++;
+			continue;
+		}
+		const Elf_t* elf = find_elf(s.thrid);
+		const char* name = 0;
+		if (elf  &&  elf->addr)
+			elf_symbol(elf->addr, elf->sz, s.pc, &name, 0);
+		funcs_cnt = add_sample(funcs_cnt, elf, name);
+	}
+
+	wrm_logi("samples:  %u, idle:  %u, others:  %u.\n", cnt, idle, others);
+	wrm_logi("%6s  %5s  %-14s  %s\n", "count", "%", "file", "function");
+	for (unsigned n=0; n<top; ++n)
+	{
+		Func_t* best = 0;
+		for (unsigned i=0; i<funcs_cnt; ++i)
+			if (funcs[i].cnt  &&  (!best  ||  funcs[i].cnt > best->cnt))
+				best = &funcs[i];
+		if (!best)
+			break;
+		unsigned promile = 1000 * best->cnt / cnt;
+		wrm_logi("%6u  %3u.%u  %-14s  %s\n", best->cnt, promile/10, promile%10,
+			best->elf ? best->elf->file : "-", best->name ? best->name : "?");
+		best->cnt = 0;
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	unsigned seconds = argc>=2 ? strtoul(argv[1], 0, 10) : 0;
+	unsigned top = argc>=3 ? strtoul(argv[2], 0, 10) : 0;
+	if (!seconds)
+		seconds = 5;
+	if (!top)
+		top = 20;
+
+	addr_t addr = -1;
+	size_t sz = Ramfs_sz;
+	paddr_t pa = 0;
+	int rc = wrm_mem_get_named("ramfs", &addr, &sz, &pa);
+	if (rc)
+	{
+		wrm_loge("wrm_mem_get_named(ramfs) - rc=%d.\n", rc);
+		return -1;
+	}
+	rc = wrm_ramfs_attach(addr, sz);
+	if (rc)
+	{
+		wrm_loge("wrm_ramfs_attach() - rc=%d.\n", rc);
+		return -1;
+	}
+	if (parse_config())
+		return -1;
+
+	for (unsigned pass=0; ; ++pass)
+	{
+		wrm_kprof(L4_kprof_start, 0, 0);
+		sleep(seconds);
+		wrm_kprof(L4_kprof_stop, 0, 0);
+		int cnt = wrm_kprof(L4_kprof_read, samples, Samples_max);
+		if (cnt <= 0)
+		{
+			wrm_loge("no samples, rc=%d, is kernel built with usr_krn_kprof=0?\n", cnt);
+			return -2;
+		}
+		wrm_logi("pass %u:\n", pass);
+		report(cnt, top);
+	}
+	return 0;
+}
@@ -0,0 +1,226 @@
+//##################################################################################################
+//
+//  strbench - string item IPC throughput between two address spaces.
+//
+//  Client sends string items of 64 B .. 64 KB to server in another aspace, kernel copies them
+//  page by page through per-CPU copy window. Every size is sent as simple string and as
+//  compound string of 4 substrings. Server checks data and replies with error code.
+//
+//  Stress mode is for several client aspaces at once: server receives strings from them in turn,
+//  so every copy goes through window remapped while other aspace was current. Client sends
+//  strings of different sizes and offsets with own seed, server checks every byte.
+//
+//  Usage (alph args):
+//    strbench server
+//    strbench client [rounds]    - rounds for 64 KB strings, smaller sizes use more rounds
+//    strbench stress <seed>      - send strings with seed forever
+//
+//##################################################################################################
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "l4_api.h"
+#include "wrmos.h"
+
+enum
+{
+	Label     = 0x124,      // any label not used by kernel extentions
+	Size_min  = 64,
+	Size_max  = 64 * 1024,
+	Substrs   = 4,          // substrings in compound string
+	Offs_max  = 61,         // max offset of stress string in buffer, to cross pages unaligned
+	Log_rounds = 1000       // stress rounds between reports
+};
+
+static const char* server_name = "strbench-srv";
+static uint8_t buf[Size_max] __attribute__((aligned(Size_min)));
+
+static inline uint8_t pattern(unsigned i, unsigned sz)
+{
+	return (uint8_t)(i * 7 + sz);
+}
+
+static int server()
+{
+	word_t key0 = 0;
+	word_t key1 = 0;
+	int rc = wrm_nthread_register(server_name, &key0, &key1);
+	if (rc)
+	{
+		wrm_loge("server:  wrm_nthread_register(%s) - rc=%d.\n", server_name, rc);
+		return -1;
+	}
+
+	memset(buf, 0, sizeof(buf));  // map all pages of receive buffer
+
+	L4_utcb_t* utcb = l4_utcb();
+	L4_acceptor_t acceptor = L4_acceptor_t::create(L4_fpage_t::create_nil(), true); // allow strings
+	L4_string_item_t bitem = L4_string_item_t::create_simple((word_t)buf, sizeof(buf));
+
+	L4_thrid_t from = L4_thrid_t::Nil;
+	utcb->br[0] = acceptor.raw();
+	utcb->br[1] = bitem.word0();
+	utcb->br[2] = bitem.word1();
+	rc = l4_receive(L4_thrid_t::Any, L4_time_t::Never, &from);
+	while (!rc)
+	{
+		L4_msgtag_t tag = utcb->msgtag();
+		word_t ecode = 0;
+		if ((tag.untyped() != 0  &&  tag.untyped() != 2)  ||  tag.typed() < 2)
+		{
+			ecode = 1;
+		}
+		else if (!tag.untyped())
+		{
+			// string is placed to buffer as a stream of substrings
+			L4_string_item_t sitem = L4_string_item_t::create(utcb->mr[1], utcb->mr[2]);
+			unsigned sz = sitem.length() * sitem.substring_number();
+			if (buf[0] != pattern(0, sz)  ||  buf[sz/2] != pattern(sz/2, sz)  ||  buf[sz-1] != pattern(sz-1, sz))
+				ecode = 2;
+		}
+		else
+		{
+			// stress string:  mr[1] - seed, mr[2] - offset of string in client's buffer
+			unsigned seed = utcb->mr[1];
+			unsigned offs = utcb->mr[2];
+			L4_string_item_t sitem = L4_string_item_t::create(utcb->mr[3], utcb->mr[4]);
+			unsigned sz = sitem.length();
+			for (unsigned i=0; i<sz; ++i)
+			{
+				if (buf[i] != pattern(offs + i, seed))
+				{
+					wrm_loge("server:  seed=%u, sz=%u, offs=%u:  wrong byte %u.\n", seed, sz, offs, i);
+					ecode = 2;
+					break;
+				}
+			}
+		}
+
+		tag.set_ipc(Label, 1, 0);
+		utcb->mr[0] = tag.raw();
+		utcb->mr[1] = ecode;
+		utcb->br[0] = acceptor.raw();
+		utcb->br[1] = bitem.word0();
+		utcb->br[2] = bitem.word1();
+		rc = l4_ipc(from, L4_thrid_t::Any, L4_timeouts_t(L4_time_t::Zero, L4_time_t::Never), &from);
+	}
+	wrm_loge("server:  l4_ipc() - rc=%d.\n", rc);
+	return -1;
+}
+
+static int measure(L4_thrid_t srv, unsigned sz, unsigned substrs, unsigned rounds)
+{
+	for (unsigned i=0; i<sz; ++i)
+		buf[i] = pattern(i, sz);
+
+	L4_utcb_t* utcb = l4_utcb();
+	utcb->br[0] = L4_acceptor_t::create(L4_fpage_t::create_nil(), false).raw();
+
+	L4_clock_t start = l4_system_clock();
+	for (unsigned i=0; i<rounds; ++i)
+	{
+		// build string item in place, compound substrings are stored in next MRs
+		L4_string_item_t* sitem = (L4_string_item_t*) &utcb->mr[1];
+		sitem->simple((word_t)buf, sz / substrs);
+		sitem->_compound.s.last = substrs - 1;
+		for (unsigned j=0; j<substrs; ++j)
+			sitem->pointer(j, (word_t)buf + j * (sz / substrs));
+
+		L4_msgtag_t tag;
+		tag.set_ipc(Label, 0, 1 + substrs);
+		utcb->mr[0] = tag.raw();
+		int rc = l4_ipc(srv, srv, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never));
+		if (rc  ||  utcb->mr[1])
+		{
+			wrm_loge("client:  l4_ipc() - rc=%d, ecode=%lu.\n", rc, (unsigned long)utcb->mr[1]);
+			return -1;
+		}
+	}
+	L4_clock_t spent = l4_system_clock() - start;
+	if (!spent)
+		spent = 1;
+
+	unsigned long long bytes = (unsigned long long)sz * rounds;
+	wrm_logi("sz=%6u, substrs=%u:  %u round trips for %llu usec, %llu nsec per round trip, %llu KB/s.\n",
+		sz, substrs, rounds, (unsigned long long)spent, (unsigned long long)spent * 1000 / rounds,
+		bytes * 1000000 / 1024 / spent);
+	return 0;
+}
+
+static int client(unsigned rounds)
+{
+	// server may be not registered yet
+	L4_thrid_t srv = L4_thrid_t::Nil;
+	word_t key0 = 0;
+	word_t key1 = 0;
+	while (wrm_nthread_get_id(server_name, &srv, &key0, &key1))
+		sleep(1);
+
+	for (unsigned pass=0; ; ++pass)
+	{
+		wrm_logi("pass %u:\n", pass);
+		for (unsigned sz=Size_min; sz<=Size_max; sz*=4)
+		{
+			// keep the same amount of copied data for all sizes
+			unsigned n = rounds * (Size_max / sz);
+			if (measure(srv, sz, 1, n)  ||  measure(srv, sz, Substrs, n))
+				return -2;
+		}
+	}
+	return 0;
+}
+
+static int stress(unsigned seed)
+{
+	L4_thrid_t srv = L4_thrid_t::Nil;
+	word_t key0 = 0;
+	word_t key1 = 0;
+	while (wrm_nthread_get_id(server_name, &srv, &key0, &key1))
+		sleep(1);
+
+	for (unsigned i=0; i<Size_max; ++i)
+		buf[i] = pattern(i, seed);
+
+	L4_utcb_t* utcb = l4_utcb();
+	utcb->br[0] = L4_acceptor_t::create(L4_fpage_t::create_nil(), false).raw();
+
+	for (unsigned round=1; ; ++round)
+	{
+		// sizes from few bytes to almost whole buffer, not aligned to pages
+		unsigned offs = round % (Offs_max + 1);
+		unsigned sz = 1 + (round * 4099) % (Size_max - Offs_max);
+
+		L4_msgtag_t tag;
+		tag.set_ipc(Label, 2, 2);
+		utcb->mr[0] = tag.raw();
+		utcb->mr[1] = seed;
+		utcb->mr[2] = offs;
+		*(L4_string_item_t*) &utcb->mr[3] = L4_string_item_t::create_simple((word_t)buf + offs, sz);
+		int rc = l4_ipc(srv, srv, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never));
+		if (rc  ||  utcb->mr[1])
+		{
+			wrm_loge("stress:  seed=%u, round=%u, l4_ipc() - rc=%d, ecode=%lu.\n",
+				seed, round, rc, (unsigned long)utcb->mr[1]);
+			return -1;
+		}
+		if (!(round % Log_rounds))
+			wrm_logi("stress:  seed=%u, %u rounds ok.\n", seed, round);
+	}
+	return 0;
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc >= 2  &&  !strcmp(argv[1], "server"))
+		return server();
+
+	if (argc >= 2  &&  !strcmp(argv[1], "stress"))
+		return stress(argc>=3 ? strtoul(argv[2], 0, 10) : 0);
+
+	unsigned rounds = argc>=3 ? strtoul(argv[2], 0, 10) : 0;
+	if (!rounds)
+		rounds = 100;
+	return client(rounds);
+}
@@ -11,6 +11,7 @@
 //#include "arch_data.h"
 
 void arch_init();
+void arch_init_cpu();
 void arch_set_timer_va(long va);
 void arch_set_ksp(long ksp);
 long arch_get_ksp();
@@ -7,10 +7,11 @@
 #include "arch.h"
 #include "sys_stack.h"
 #include "sys_proc.h"
+#include "kconfig.h"
 
 void arch_init()
 {
-	// nothing for arm
+	// cycle counter is started by bootstrap() on every CPU
 }
 
 void arch_set_timer_va(long va)
@@ -19,6 +20,35 @@ void arch_set_timer_va(long va)
 	timer_va = va;
 }
 
+#if Cfg_krn_smp
+
+// entry asm code gets address of cur_ksp[cpu] from TPIDRPRW
+void arch_init_cpu()
+{
+	extern unsigned cur_ksp[Cfg_max_cpus];
+	unsigned* ksp = &cur_ksp[Proc::cpuid()];
+	asm volatile ("mcr  p15, 0, %0, c13, c0, 4" :: "r"(ksp));  // TPIDRPRW
+}
+
+void arch_set_ksp(long ksp)
+{
+	extern unsigned cur_ksp[Cfg_max_cpus];
+	cur_ksp[Proc::cpuid()] = ksp;
+}
+
+long arch_get_ksp()
+{
+	extern unsigned cur_ksp[Cfg_max_cpus];
+	return cur_ksp[Proc::cpuid()];
+}
+
+#else
+
+void arch_init_cpu()
+{
+	// nothing for UP kernel
+}
+
 void arch_set_ksp(long ksp)
 {
 	extern unsigned cur_ksp;
@@ -31,6 +61,8 @@ long arch_get_ksp()
 	return cur_ksp;
 }
 
+#endif
+
 void __attribute__((section(".user.text"))) arch_user_invoke()
 {
 	// load UTCB address from top of the stack to 0xff000000
@@ -39,6 +71,7 @@ void __attribute__((section(".user.text"))) arch_user_invoke()
 		"ldr  r3, [ sp ]    \n" // get UTCB address
 		"mov  r4, #0xff000000  \n" // 
 		"str  r3, [ r4 ]    \n" // 
+		"mcr  p15, 0, r3, c13, c0, 3 \n" // and to TPIDRURO, 0xff000000 is shared by all CPUs
 		"add  sp, sp, #4    \n" // correct sp after pop start address
 	);
 
@@ -75,6 +108,7 @@ void arch_switch_cpu(addr_t* cur_ksp, addr_t nxt_ksp, word_t nxt_utcb)
 {
 	// set utcb
 	*((word_t*)0xff000000) = nxt_utcb;
+	asm volatile ("mcr  p15, 0, %0, c13, c0, 3" :: "r"(nxt_utcb));  // TPIDRURO
 
 	// store user and kernel contexts and return address on kstack
 	asm volatile
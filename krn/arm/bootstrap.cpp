@@ -27,6 +27,9 @@ static word_t l2tab [Cfg_max_cpus][Karea_sz/L1_pgsz][L2_sz] __attribute__((align
 // turn on MMU and go to virtual address space
 extern "C" void bootstrap()
 {
+	// start PMU cycle counter of this CPU before anybody reads it (sched stats, ktrace, apps)
+	Proc::cycles_init();
+
 	// initialize page tables
 	addr_t kern_va = (addr_t)&_kern_vaddr;
 	addr_t kern_pa = (addr_t)&_kern_vaddr - (addr_t)&_diff_va_pa;
@@ -18,6 +18,7 @@ extern "C" void arm_entry_undef(addr_t spsr, addr_t inst)
 
 extern "C" void arm_entry_iabort(addr_t spsr, addr_t inst)
 {
+	Smp::lock();
 	Sched_t::current()->tmevent_kentry_end(SystemClock_t::sys_clock(__func__));
 
 	addr_t inst_fault_addr = 0;
@@ -43,10 +44,12 @@ extern "C" void arm_entry_iabort(addr_t spsr, addr_t inst)
 	kentry_pagefault(inst_fault_addr, Acc_x, inst);
 
 	Sched_t::current()->tmevent_kexit_start(SystemClock_t::sys_clock(__func__));
+	Smp::unlock();
 }
 
 extern "C" void arm_entry_dabort(addr_t spsr, addr_t inst)
 {
+	Smp::lock();
 	Sched_t::current()->tmevent_kentry_end(SystemClock_t::sys_clock(__func__));
 
 	addr_t data_fault_addr = 0;
@@ -74,6 +77,7 @@ extern "C" void arm_entry_dabort(addr_t spsr, addr_t inst)
 	kentry_pagefault(data_fault_addr, access, inst);
 
 	Sched_t::current()->tmevent_kexit_start(SystemClock_t::sys_clock(__func__));
+	Smp::unlock();
 }
 
 extern "C" void arm_entry_reset(addr_t spsr, addr_t inst)
@@ -85,6 +89,17 @@ extern "C" void arm_entry_reset(addr_t spsr, addr_t inst)
 extern "C" void arm_entry_irq(addr_t spsr, addr_t inst)
 {
 	unsigned irq = Intc::irq();
+
+	#if Cfg_krn_smp
+	// raw ICCIAR value contains source CPU id for SGI
+	if ((irq & 0x3ff) == 1023)
+		return;  // spurious, irq was taken by other CPU
+	if (Smp::is_ipi(irq & 0x3ff))
+		Intc::eoi_ack(irq);  // ipi handler may switch context, eoi it now
+	irq &= 0x3ff;
+	#endif
+
+	Smp::lock();
 	Sched_t::current()->tmevent_kentry_end(SystemClock_t::sys_clock(__func__, irq==Cfg_krn_timer_irq));
 
 	(void)spsr;
@@ -92,6 +107,7 @@ extern "C" void arm_entry_irq(addr_t spsr, addr_t inst)
 	kentry_irq(irq);
 
 	Sched_t::current()->tmevent_kexit_start(SystemClock_t::sys_clock(__func__));
+	Smp::unlock();
 }
 
 static void dprint1(const char* fmt, ...)
@@ -105,6 +121,7 @@ static void dprint1(const char* fmt, ...)
 
 extern "C" void arm_entry_fiq(addr_t spsr, addr_t inst)
 {
+	Smp::lock();
 	Sched_t::current()->tmevent_kentry_end(SystemClock_t::sys_clock(__func__));
 
 	printf("fiq_trap:  spsr=0x%lx, inst=0x%lx.\n", spsr, inst);
@@ -112,15 +129,18 @@ extern "C" void arm_entry_fiq(addr_t spsr, addr_t inst)
 	panic("TODO");
 
 	Sched_t::current()->tmevent_kexit_start(SystemClock_t::sys_clock(__func__));
+	Smp::unlock();
 }
 
 extern "C" void arm_entry_syscall(word_t inst)
 {
+	Smp::lock();
 	Sched_t::current()->tmevent_kentry_end(SystemClock_t::sys_clock(__func__));
 
 	(void) inst;
 	kentry_syscall();
 
 	Sched_t::current()->tmevent_kexit_start(SystemClock_t::sys_clock(__func__));
+	Smp::unlock();
 }
 
@@ -8,6 +8,7 @@
 #include "threads.h"
 #include "kuart.h"
 #include "l4_syscalls.h"
+#include "mapdb.h"
 #include <assert.h>
 
 
@@ -32,7 +33,7 @@ inline uint8_t load_phys_byte(addr_t pa)
 	return ptr[pa - aligned_pa];
 }
 
-// src, dst and len may be not aligned by sizeof(word_t)
+// src, dst and len may be not aligned by sizeof(word_t), dst_pa..dst_pa+len is inside one page
 static void memcpy_phys_dst(addr_t src, addr_t dst_pa, size_t len)
 {
 	printk("%s:  src=0x%lx, dst_pa=0x%lx, len=0x%zx.\n", __func__, src, dst_pa, len);
@@ -54,17 +55,14 @@ static void memcpy_phys_dst(addr_t src, addr_t dst_pa, size_t len)
 	}
 	else
 	{
-		// alloc kspace, map dst_pa to it, copy, unmap, free kspace
-		size_t sz = round_pg_up(dst_pa + len) - round_pg_down(dst_pa);
-		addr_t kva = Aspace::alloc_kspace(sz);
-		Sched_t::current()->task()->map(kva, round_pg_down(dst_pa), sz, Acc_kdata, Cachable);
-		memcpy((void*)(kva + get_pg_offset(dst_pa)), (const void*)src, len);
-		Sched_t::current()->task()->unmap(kva, sz);
-		Aspace::free_kspace(kva, sz);
+		// use per-CPU copy window
+		wassert(round_pg_down(dst_pa) == round_pg_down(dst_pa + len - 1));
+		addr_t kva = Aspace::kmap_copy_win(dst_pa, Acc_kdata);
+		memcpy((void*)kva, (const void*)src, len);
 	}
 }
 
-// src, dst and len may be not aligned by sizeof(word_t)
+// src, dst and len may be not aligned by sizeof(word_t), src_pa..src_pa+len is inside one page
 static void memcpy_phys_src(addr_t src_pa, addr_t dst, size_t len)
 {
 	printk("%s:  src_pa=0x%lx, dst=0x%lx, len=0x%zx.\n", __func__, src_pa, dst, len);
@@ -85,8 +83,10 @@ static void memcpy_phys_src(addr_t src_pa, addr_t dst, size_t len)
 	}
 	else
 	{
-		// make like in memcpy_phys_dst(), but use Acc_krodata
-		panic("%s: IMPLME", __func__);
+		// use per-CPU copy window
+		wassert(round_pg_down(src_pa) == round_pg_down(src_pa + len - 1));
+		addr_t kva = Aspace::kmap_copy_win(src_pa, Acc_krodata);
+		memcpy((void*)dst, (const void*)kva, len);
 	}
 }
 
@@ -105,32 +105,38 @@ static void copy_thread_buf(addr_t src, addr_t dst, size_t len, const Thread_t*
 		assert(snd->task() == Sched_t::current()->task());
 		memcpy((void*)dst, (void*)src, len);
 	}
-	// dst is another aspace
+	// dst is another aspace, copy page by page of dst
 	else if (snd->task() == Sched_t::current()->task())
 	{
-		if (round_pg_down(dst) != round_pg_down(dst + len - 1))
-			panic("TODO:  remote dst aspace is page crossed - process it.\n");
-
-		paddr_t dst_pa = rcv->task()->walk(round_pg_down(dst), round_pg_up(len) /*, TODO: acc*/);
-		printk("%s:  dst_pa=0x%x.\n", __func__, (int)dst_pa);
-		assert(dst_pa);
-		dst_pa += get_pg_offset(dst);
-
-		memcpy_phys_dst(src, dst_pa, len);
+		while (len)
+		{
+			size_t sz = min(len, Cfg_page_sz - get_pg_offset(dst));
+			paddr_t dst_pa = rcv->task()->walk(round_pg_down(dst), Cfg_page_sz /*, TODO: acc*/);
+			printk("%s:  dst_pa=0x%x.\n", __func__, (int)dst_pa);
+			assert(dst_pa);
+
+			memcpy_phys_dst(src, dst_pa + get_pg_offset(dst), sz);
+			src += sz;
+			dst += sz;
+			len -= sz;
+		}
 	}
-	// src is another aspace
+	// src is another aspace, copy page by page of src
 	else
 	{
 		assert(rcv->task() == Sched_t::current()->task());
-		if (round_pg_down(src) != round_pg_down(src + len - 1))
-			panic("TODO:  remote src aspace is page crossed - process it.\n");
-
-		paddr_t src_pa = snd->task()->walk(round_pg_down(src), round_pg_up(len) /*, TODO: acc*/);
-		printk("%s:  src_pa=0x%x.\n", __func__, (int)src_pa);
-		assert(src_pa);
-		src_pa += get_pg_offset(src);
-
-		memcpy_phys_src(src_pa, dst, len);
+		while (len)
+		{
+			size_t sz = min(len, Cfg_page_sz - get_pg_offset(src));
+			paddr_t src_pa = snd->task()->walk(round_pg_down(src), Cfg_page_sz /*, TODO: acc*/);
+			printk("%s:  src_pa=0x%x.\n", __func__, (int)src_pa);
+			assert(src_pa);
+
+			memcpy_phys_src(src_pa + get_pg_offset(src), dst, sz);
+			src += sz;
+			dst += sz;
+			len -= sz;
+		}
 	}
 }
 
@@ -151,6 +157,7 @@ static int do_normal_ipc(Thread_t* snd, Thread_t* rcv, bool propagated, bool use
 
 	// copy msg_tag and from_id to dest
 	rutcb->mr[0] = tag.raw();
+	rcv->ipcstat_transfer(snd);
 	word_t real_sender = use_local_id ? snd->localid().raw() : snd->globid().raw();
 	if (propagated)
 	{
@@ -287,10 +294,15 @@ static int do_normal_ipc(Thread_t* snd, Thread_t* rcv, bool propagated, bool use
 						res_item.set(L4_fpage_t::create(dst_va, dst_sz, dst_acc));
 					}
 
+					if (mitem->is_grant())
+						Mapdb::grant(snd->task(), snd_fpage.addr(), rcv->task(), dst_va, dst_sz);
+					else
+						Mapdb::map(snd->task(), snd_fpage.addr(), rcv->task(), dst_va, dst_sz);
+
 					rcv->task()->map(dst_va, pa, dst_sz, Aspace::uacc2acc(dst_acc), cached);
 
 					if (mitem->is_grant())
-						rcv->task()->unmap(snd_fpage.addr(), snd_fpage.addr());
+						snd->task()->unmap(snd_fpage.addr(), snd_fpage.size());
 				}
 				rutcb->mr[i+0] = res_item.word0();
 				rutcb->mr[i+1] = res_item.word1();
@@ -311,44 +323,60 @@ static int do_normal_ipc(Thread_t* snd, Thread_t* rcv, bool propagated, bool use
 				L4_string_item_t* sitem = (L4_string_item_t*) item;
 
 				L4_string_item_t bitem = L4_string_item_t::create(rutcb->br[next_buf], rutcb->br[next_buf+1]);
+				const word_t* bptrs = &rutcb->br[next_buf+1];  // buffer substring pointers
+				unsigned bnum = bitem.substring_number();
+				if (next_buf + bnum > sizeof(rutcb->br) / sizeof(rutcb->br[0]) - 1)
+				{
+					printk("do_ipc:  ERR:  bitem point out of br:  buf_reg=%u, bnum=%u.\n", next_buf, bnum);
+					assert(false);
+					return 2;
+				}
 
 				if (bitem.is_last())
 					next_buf = -1;  // no more buffers
 				else
-					next_buf += 1 + bitem.substring_number();
+					next_buf += 1 + bnum;
 
-				// copy string items (simple or compound) one by one
+				// copy substrings of string item to substrings of buffer item (both may be simple
+				// or compound) as a stream, a substring may be split between two buffers
 				rutcb->mr[i] = sitem->word0();
 				unsigned num = sitem->substring_number();
+				size_t slen = sitem->length();
+				size_t blen = bitem.length();
+				unsigned bj = 0;    // current buffer substring
+				size_t boff = 0;    // offset in current buffer substring
 				for (unsigned j=0; j<num; ++j)
 				{
 					//printk("++ %s() - substring, i=%u, j=%u.\n", __func__, i, j);
-					if (i+j > last)
+					if (i+1+j > last)
 					{
 						printk("do_ipc:  ERR:  sitem point out of msg:  untyped=%u, typed=%u, sitem_reg=%u, sstr_reg=%u.\n",
-							tag.untyped(), tag.typed(), i, i+j);
+							tag.untyped(), tag.typed(), i, i+1+j);
 						assert(false);
 						return 2;
 					}
 
 					// copy str_item data to buf_item buffers
+					rutcb->mr[i+1+j] = bj < bnum ? bptrs[bj] + boff : 0;
+					size_t done = 0;
+					while (done < slen  &&  bj < bnum)
+					{
+						size_t len = min(slen - done, blen - boff);
+						copy_thread_buf(sitem->pointer(j) + done, bptrs[bj] + boff, len, snd, rcv);
+						done += len;
+						boff += len;
+						bytes_copied += len;
+						if (boff == blen)
+						{
+							bj++;
+							boff = 0;
+						}
+					}
 
-					if (sitem->substring_number() > 1)
-						panic("TODO:  support compound strings.\n");
-
-					if (bitem.substring_number() > 1)
-						panic("TODO:  support compound buffers.\n");
-
-					unsigned len = min(sitem->length(), bitem.length());
-					copy_thread_buf(sitem->pointer(j), bitem.pointer(0), len, snd, rcv);
-
-					rutcb->mr[i+1+j] = (word_t)bitem.pointer(0);
-					bytes_copied += len;
-
-					if (len < sitem->length())
+					if (done < slen)
 					{
-						printk("do_ipc:  WRN:  strlen=%u, buflen=%u;  TODO:  return err to sndr and rcvr and offset = bytes_copied.\n",
-							sitem->length(), bitem.length());
+						printk("do_ipc:  WRN:  strlen=%u, buflen=%u, subbufs=%u;  TODO:  return err to sndr and rcvr and offset = bytes_copied.\n",
+							sitem->length(), bitem.length(), bnum);
 
 						// sender anf receiver will get MsgOverflow error
 						sutcb->ipc_error_code(L4_ipcerr_t(L4_snd_phase, L4_ipc_overflow, bytes_copied));
@@ -440,7 +468,7 @@ void process_pfault(Thread_t* fault_thr, word_t fault_addr, word_t fault_access,
 {
 	printk("pfault:  addr=0x%lx, access=%ld, inst=0x%lx.\n", fault_addr, fault_access, fault_inst);
 
-	Thread_t* pgr = fault_thr->pager();
+	Thread_t* pgr = threads_find(fault_thr->pagerid());  // pager may be deleted
 	if (!pgr)
 		panic("pagefault:  no pager.");
 
@@ -505,8 +533,71 @@ void process_exception(Thread_t* fault_thr, int exc_type, word_t pfault_addr_and
 	}
 }
 
+// Receiver already waits for us and sender will wait for reply, so hand CPU to receiver
+// directly, without items parsing, sender queues and prio inheritance. Used by fast path and
+// local IPC. Return false to go to the generic path.
+static bool do_direct_ipc(Thread_t& cur, Thread_t* dst, L4_thrid_t from_spec, L4_timeouts_t timeouts,
+                          bool local)
+{
+	L4_utcb_t*  sutcb = cur.uutcb();
+	L4_msgtag_t tag   = sutcb->msgtag();
+
+	// untyped message, both phases, no extentions and protocols
+	if (tag.typed()  ||  tag.propagated()  ||  tag.ipc_label() == 0x202  ||
+	    tag.is_pf_request()  ||  tag.is_io_pf_request()  ||  timeouts.rcv().is_zero())
+		return false;
+
+	// nobody waits for send to us, otherwise receive phase will not block
+	if (cur.snd_first()  ||  cur.prio_heir())
+		return false;
+
+	// receiver waits for us on this CPU and doesn't need prio inheritance
+	bool use_local_id = false;
+	if (!dst  ||  dst->state() != Thread_t::Receive_ipc  ||  !dst->is_good_sender(&cur, &use_local_id)  ||
+	    dst->prio() < cur.prio_max()  ||  dst->prio_heir()  ||
+	    dst->cpu() != cur.cpu()  ||  dst->cpu_migrate() != Thread_t::No_cpu)
+		return false;
+
+	// copy message
+	L4_utcb_t* rutcb = dst->utcb();
+	tag.ipc_set_ok();
+	sutcb->mr[0] = tag.raw();
+	rutcb->mr[0] = tag.raw();
+	for (int i=1; i<=tag.untyped(); ++i)
+		rutcb->mr[i] = sutcb->mr[i];
+	bool from_local = use_local_id  ||  (local  &&  dst->ipc_from_spec() != cur.globid());
+	dst->entry_frame()->scall_ipc_from(from_local ? cur.localid().raw() : cur.globid().raw());
+	dst->ipcstat_transfer(&cur);
+
+	// direct switch, wait for reply
+	cur.ipc_handoff(dst, timeouts.rcv(), from_spec);
+	Sched_t::switch_to(dst);
+	return true;
+}
+
+#if Cfg_krn_fastipc
+// Fast path for short call and reply-and-wait to any thread.
+static bool do_fast_ipc(Thread_t& cur, Entry_frame_t& eframe)
+{
+	L4_thrid_t    to        = eframe.scall_ipc_to();
+	L4_thrid_t    from_spec = eframe.scall_ipc_from_spec();
+	L4_timeouts_t timeouts  = eframe.scall_ipc_timeouts();
+
+	if (cur.uutcb()->msgtag().untyped() > Kcfg::Fast_ipc_words  ||  !to.is_single()  ||
+	    thrid_is_int(to)  ||  !(from_spec.is_any()  ||  from_spec == to))
+		return false;
+
+	return do_direct_ipc(cur, Threads_t::find(to), from_spec, timeouts, false);
+}
+#endif
+
 void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 {
+	#if Cfg_krn_fastipc
+	if (do_fast_ipc(cur, eframe))
+		return;
+	#endif
+
 	L4_thrid_t    to        = eframe.scall_ipc_to();
 	L4_thrid_t    from_spec = eframe.scall_ipc_from_spec();
 	L4_timeouts_t timeouts  = eframe.scall_ipc_timeouts();
@@ -525,8 +616,8 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 	// send phase
 	if (!to.is_nil())
 	{
-		// interrupt re-enable message
-		if (thrid_is_int(to)  &&  tag.untyped() == 1)  // re-enable msg
+		// interrupt re-enable message or wrm extention:  coalescing setup
+		if (thrid_is_int(to)  &&  (tag.untyped() == 1  ||  tag.untyped() == 3))
 		{
 			word_t flags = utcb->mr[1];
 			unsigned irq = to.number();
@@ -540,22 +631,40 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 				return;
 			}
 
-			Intc::eoi(irq);
-
-			printk("ipc:  re-enable interrupt %u.\n", irq);
-			if (flags & 0x1)  // flags:  is need clear befor unmask ?
-				Intc::clear(irq);
-
-			if (Intc::is_pending(irq))
+			if (tag.untyped() == 3)
 			{
-				//force_printk_uart("ipc:  already pending irq=%u.\n", irq);
-				Intc::clear(irq);
-				Threads_t::int_thread(irq)->pending(true);
+				// wrm extention:  mr2 - usec, mr3 - events, see Int_thread_t
+				printk("ipc:  coalesce interrupt %u:  usec=%u, events=%u.\n",
+					irq, (unsigned)utcb->mr[2], (unsigned)utcb->mr[3]);
+				if (ithr->hold()  &&  !ithr->is_counting())
+					Intc::unmask(irq);  // held after ack
+				ithr->coalesce(utcb->mr[2], utcb->mr[3]);
 			}
 			else
 			{
-				// wait
-				Intc::unmask(irq);
+				if (!ithr->eoi_done())
+					Intc::eoi(irq);
+				ithr->eoi_done(false);
+
+				printk("ipc:  re-enable interrupt %u.\n", irq);
+				if (flags & 0x1)  // flags:  is need clear befor unmask ?
+					Intc::clear(irq);
+
+				if (ithr->hold_on_ack())
+				{
+					// coalescing:  keep masked till hold expiry, see check_int_holds()
+				}
+				else if (Intc::is_pending(irq))
+				{
+					//force_printk_uart("ipc:  already pending irq=%u.\n", irq);
+					Intc::clear(irq);
+					Threads_t::int_thread(irq)->pending(true);
+				}
+				else
+				{
+					// wait
+					Intc::unmask(irq);
+				}
 			}
 		}
 		else
@@ -630,7 +739,7 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 
 					dst->state(Thread_t::Ready);
 					snd_partner = dst;
-					assert(dst->prio_heir().is_nil());
+					assert(!dst->prio_heir());
 				}
 				// if fpage is not nil - do mapping and resume dst thread
 				else if (!fpage.is_nil())
@@ -656,16 +765,22 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 					//	cur.task()->dump();
 					assert(pa);
 					assert(cur.id() != 1/*sigma0*/  ||  pa == fpage.addr());
-					addr_t va = round_down(dst->pf_addr(), Cfg_page_sz);
+					// fpage may be larger than page, place it to aligned block that contains fault address
+					addr_t va = round_down(dst->pf_addr(), fpage.size());
+
+					if (item->is_grant())
+						Mapdb::grant(cur.task(), fpage.addr(), dst->task(), va, fpage.size());
+					else
+						Mapdb::map(cur.task(), fpage.addr(), dst->task(), va, fpage.size());
 
 					dst->task()->map(va, pa, fpage.size(), Aspace::uacc2acc(fpage.access()), Cachable);
 
 					if (item->is_grant())
-						dst->task()->unmap(fpage.addr(), fpage.size());
+						cur.task()->unmap(fpage.addr(), fpage.size());
 
 					dst->state(Thread_t::Ready);
 					snd_partner = dst;
-					assert(dst->prio_heir().is_nil());
+					assert(!dst->prio_heir());
 				}
 				// fpage is nil - skip mapping and just resume dst thread
 				else
@@ -674,7 +789,7 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 					assert(fpage.is_nil());
 					dst->state(Thread_t::Ready);
 					snd_partner = dst;
-					assert(dst->prio_heir().is_nil());
+					assert(!dst->prio_heir());
 				}
 			}
 			// TODO:  check that msg from exc-handler
@@ -685,7 +800,7 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 				memcpy(dst->entry_frame(), &utcb->mr[2], sizeof(Entry_frame_t));
 				dst->state(Thread_t::Ready);
 				snd_partner = dst;
-				assert(dst->prio_heir().is_nil());
+				assert(!dst->prio_heir());
 			}
 			// wrm extention - trigger software irq
 			else if (tag.ipc_label() == 0x202)
@@ -759,12 +874,9 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 				// receiver is not ready for ipc, wait
 				else
 				{
-					// inherit prio if need - increase dst.prio up to current max prio
-					if (dst != &cur  &&  dst->prio() < cur.prio_max())
-					{
-						dst->inherit_prio_add(cur.globid(), cur.prio_max());
-						cur.prio_heir(dst->globid());
-					}
+					// give our prio to dst while we are blocked on it, it is returned on leaving Send_ipc
+					if (dst != &cur)
+						cur.prio_inherit(dst);
 
 					// wait
 					cur.save_snd_phase(timeouts.snd(), to);
@@ -812,9 +924,10 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 					// already pending
 					tag.proto_label(L4_msgtag_t::Interrupt);
 					tag.proto_nulls();
-					tag.untyped(0);
+					tag.untyped(1);
 					tag.typed(0);
 					utcb->mr[0] = tag.raw();
+					utcb->mr[1] = isnd->notify();  // number of coalesced interrupts
 					eframe.scall_ipc_from(isnd->globid().raw());
 					isnd->pending(false);
 				}
@@ -889,14 +1002,9 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 					{
 						Thread_t* sender = Threads_t::find(from_spec);
 						assert(sender);
-						if (sender->prio() < cur.prio_max())
-						{
-							printk("ipc:  rcv:  inh prio:  myid=%u, myprio=%u, sndid=%u, sndprio=%u.\n",
-								cur.globid().number(), cur.prio_max(), sender->globid().number(), sender->prio());
-
-							sender->inherit_prio_add(cur.globid(), cur.prio_max());
-							cur.prio_heir(sender->globid());
-						}
+						printk("ipc:  rcv:  inh prio:  myid=%u, myprio=%u, sndid=%u, sndprio=%u.\n",
+							cur.globid().number(), cur.prio_max(), sender->globid().number(), sender->prio_max());
+						cur.prio_inherit(sender);
 					}
 
 					// wait
@@ -909,7 +1017,7 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 	}
 
 	assert(cur.state() == Thread_t::Ready);
-	assert(cur.prio() == cur.prio_max());
+	assert(!cur.prio_heir());
 
 	// switch to snd or rcv partner if need
 	if (snd_partner || rcv_partner)
@@ -925,3 +1033,58 @@ void do_ipc(Thread_t& cur, Entry_frame_t& eframe)
 		}
 	}
 }
+
+// thread of current task by local or global id, 0 if it is alien or doesn't exist
+static Thread_t* find_local(const Thread_t& cur, L4_thrid_t id)
+{
+	Thread_t* t = 0;
+	if (id.is_local())
+		t = cur.task()->utcb_thread(id.raw());
+	else if (id.is_global())
+		t = Threads_t::find(id);
+	return t  &&  t->task() == cur.task()  &&  t->is_active()  ?  t  :  0;
+}
+
+// Local IPC:  partner is in the same task, untyped message of any length goes by direct
+// switch, software irq trigger wakes waiting thread without generic path. Other cases and
+// alien partners are processed by generic IPC with the same semantics.
+void do_lipc(Thread_t& cur, Entry_frame_t& eframe)
+{
+	L4_thrid_t    to        = eframe.scall_ipc_to();
+	L4_thrid_t    from_spec = eframe.scall_ipc_from_spec();
+	L4_timeouts_t timeouts  = eframe.scall_ipc_timeouts();
+	L4_utcb_t*    utcb      = cur.uutcb();
+	L4_msgtag_t   tag       = utcb->msgtag();
+	Thread_t*     dst       = find_local(cur, to);
+
+	printk("lipc entry:  snd=%d, rcv=%d, u=%d, t=%d.\n", to.number(),
+		from_spec.is_any() ? -1 : from_spec.number(), tag.untyped(), tag.typed());
+
+	if (dst  &&  dst != &cur)
+	{
+		// wrm extention - trigger software irq, see generic path
+		if (tag.ipc_label() == 0x202  &&  from_spec.is_nil())
+		{
+			tag.ipc_set_ok();
+			utcb->mr[0] = tag.raw();
+			if (dst->state() == Thread_t::Receive_ipc  &&  dst->ipc_from_spec() == dst->globid())
+			{
+				dst->entry_frame()->scall_ipc_from(dst->globid().raw());
+				dst->state(Thread_t::Ready);
+				if (dst->prio_max() > cur.prio_max())
+					Sched_t::switch_to(dst);
+			}
+			else
+			{
+				dst->signal_pending(true);
+			}
+			return;
+		}
+
+		if ((from_spec.is_any()  ||  from_spec.is_any_local()  ||  find_local(cur, from_spec) == dst)  &&
+		    do_direct_ipc(cur, dst, from_spec, timeouts, true))
+			return;
+	}
+
+	do_ipc(cur, eframe);
+}
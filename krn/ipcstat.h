@@ -0,0 +1,244 @@
+//##################################################################################################
+//
+//  Ipcstat - log2 histograms of IPC latency, call round trip and blocked time.
+//
+//##################################################################################################
+
+#ifndef IPCSTAT_H
+#define IPCSTAT_H
+
+#include "kconfig.h"
+#include "sys_proc.h"
+#include "sys_utils.h"
+#include "sysclock.h"
+#include "l4_kdbops.h"
+
+// Latency is time from IPC syscall entry of sender to syscall exit of receiver, round trip is
+// time of call from entry to exit of caller, both are kept per (sender task, receiver task)
+// pair. Blocked time is time of thread in send and receive phases, it is kept in thread.
+// Collecting is off after boot, usr_krn_ipcstat=0 removes statistics from kernel.
+class Ipcstat
+{
+public:
+
+	typedef void (*Print_t)(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+	enum
+	{
+		Pairs_max = 32,
+		No_task   = ~0u,
+		#if defined(Cfg_arch_x86)  ||  defined(Cfg_arch_x86_64)
+		Usec      = 0              // 64-bit TSC
+		#else
+		Usec      = 1              // arm PMU counter is 32-bit and wraps in seconds, sparc has none
+		#endif
+	};
+
+	// per-thread data
+	struct Thr_t
+	{
+		uint64_t send;      // IPC syscall entry with send phase, 0 - no
+		uint64_t msg;       // send time of received message, 0 - unknown
+		uint64_t block;     // start of blocking in IPC, 0 - not blocked
+		unsigned msg_task;  // task of received message sender, No_task - nothing is received
+		unsigned msg_thr;   //
+		unsigned epoch;     // 'blocked' is actual if epoch is equal to Ipcstat epoch
+		L4_ipcstat_hist_t blocked;
+		Thr_t() : send(0), msg(0), block(0), msg_task(No_task), msg_thr(0), epoch(0), blocked() {}
+	};
+
+private:
+
+	struct Pair_t
+	{
+		unsigned snd_task;
+		unsigned rcv_task;
+		L4_ipcstat_pair_t pub;
+	};
+
+	static Pair_t   _pairs[Pairs_max];
+	static unsigned _cnt;    // used pairs
+	static unsigned _lost;   // samples of pairs that don't fit to table
+	static unsigned _epoch;  // incremented on start, drops blocked histograms of all threads
+	static bool     _on;
+
+	static inline uint64_t now()
+	{
+		return Usec ? SystemClock_t::sys_clock(__func__) : Proc::cycles();
+	}
+
+	static inline void add(L4_ipcstat_hist_t& h, uint64_t span)
+	{
+		unsigned n = span < 2 ? 0 : 63 - __builtin_clzll(span);
+		h.cnt[n < L4_ipcstat_buckets ? n : L4_ipcstat_buckets - 1]++;
+	}
+
+	static L4_ipcstat_pair_t* pair(unsigned snd_task, unsigned rcv_task, unsigned snd_thr, unsigned rcv_thr)
+	{
+		for (unsigned i=0; i<_cnt; ++i)
+			if (_pairs[i].snd_task == snd_task  &&  _pairs[i].rcv_task == rcv_task)
+				return &_pairs[i].pub;
+		if (_cnt == Pairs_max)
+		{
+			_lost++;
+			return 0;
+		}
+		Pair_t& p = _pairs[_cnt++];
+		memset(&p, 0, sizeof(p));
+		p.snd_task = snd_task;
+		p.rcv_task = rcv_task;
+		p.pub.snd_thr = snd_thr;
+		p.pub.rcv_thr = rcv_thr;
+		return &p.pub;
+	}
+
+	static unsigned count(const L4_ipcstat_hist_t& h)
+	{
+		unsigned sum = 0;
+		for (unsigned i=0; i<L4_ipcstat_buckets; ++i)
+			sum += h.cnt[i];
+		return sum;
+	}
+
+	static void dump_hist(Print_t dprint, const char* title, const L4_ipcstat_hist_t& h)
+	{
+		unsigned sum = count(h);
+		if (!sum)
+			return;
+		dprint("  %-8s  %8u: ", title, sum);
+		for (unsigned i=0; i<L4_ipcstat_buckets; ++i)
+			if (h.cnt[i])
+				dprint("  2^%u:%u", i, h.cnt[i]);
+		dprint("\n");
+	}
+
+public:
+
+	static inline bool on() { return Cfg_krn_ipcstat  &&  _on; }
+
+	// IPC syscall entry, 'send' - syscall has send phase
+	static inline void syscall_entry(Thr_t& t, bool send)
+	{
+		t.send = on()  &&  send ? now() : 0;
+		t.msg_task = No_task;
+	}
+
+	// message of 'snd' is transferred to 'rcv'
+	static inline void transfer(Thr_t& rcv, const Thr_t& snd, unsigned snd_task, unsigned snd_thr)
+	{
+		if (!on())
+			return;
+		rcv.msg = snd.send;
+		rcv.msg_task = snd_task;
+		rcv.msg_thr = snd_thr;
+	}
+
+	// IPC syscall exit, 'call' - send and receive partners are the same thread
+	static inline void syscall_exit(Thr_t& t, unsigned task, unsigned thr, bool call)
+	{
+		if (on()  &&  t.msg_task != No_task)
+		{
+			uint64_t end = now();
+			L4_ipcstat_pair_t* p = 0;
+			if (t.msg  &&  (p = pair(t.msg_task, task, t.msg_thr, thr)))
+				add(p->latency, end - t.msg);
+			if (call  &&  t.send  &&  (p = pair(task, t.msg_task, thr, t.msg_thr)))
+				add(p->rtt, end - t.send);
+		}
+		t.send = 0;
+		t.msg_task = No_task;
+	}
+
+	// thread enters or leaves send/receive phase of IPC
+	static void block(Thr_t& t, bool blocked)
+	{
+		if (blocked)
+		{
+			if (on()  &&  !t.block)
+				t.block = now();
+			return;
+		}
+		if (!t.block)
+			return;
+		if (on())
+		{
+			if (t.epoch != _epoch)
+			{
+				memset(&t.blocked, 0, sizeof(t.blocked));
+				t.epoch = _epoch;
+			}
+			add(t.blocked, now() - t.block);
+		}
+		t.block = 0;
+	}
+
+	// thread is deleted, drop its histogram
+	static inline void reset(Thr_t& t)
+	{
+		t.send = 0;
+		t.block = 0;
+		t.msg_task = No_task;
+		t.epoch = _epoch - 1;
+	}
+
+	static void start()
+	{
+		_cnt = 0;
+		_lost = 0;
+		_epoch++;
+		_on = Cfg_krn_ipcstat;
+	}
+
+	static void stop()
+	{
+		_on = false;
+	}
+
+	static void info(L4_ipcstat_info_t* buf)
+	{
+		buf->on    = _on;
+		buf->usec  = Usec;
+		buf->pairs = _cnt;
+		buf->lost  = _lost;
+	}
+
+	static unsigned read(L4_ipcstat_pair_t* buf, unsigned sz)
+	{
+		unsigned n = min(sz, _cnt);
+		for (unsigned i=0; i<n; ++i)
+			buf[i] = _pairs[i].pub;
+		return n;
+	}
+
+	static void read(const Thr_t& t, L4_ipcstat_hist_t* buf)
+	{
+		if (t.epoch == _epoch)
+			*buf = t.blocked;
+		else
+			memset(buf, 0, sizeof(*buf));
+	}
+
+	static void dump(Print_t dprint)
+	{
+		dprint("state:  %s, pairs:  %u, lost:  %u, max:  %u, unit:  %s.\n",
+			_on ? "on" : "off", _cnt, _lost, Pairs_max, Usec ? "usec" : "cycles");
+		for (unsigned i=0; i<_cnt; ++i)
+		{
+			const Pair_t& p = _pairs[i];
+			dprint("task %u (thr %u) -> task %u (thr %u):\n",
+				p.snd_task, p.pub.snd_thr, p.rcv_task, p.pub.rcv_thr);
+			dump_hist(dprint, "latency", p.pub.latency);
+			dump_hist(dprint, "rtt", p.pub.rtt);
+		}
+	}
+
+	static void dump(Print_t dprint, const Thr_t& t, unsigned thr, const char* name)
+	{
+		if (t.epoch != _epoch  ||  !count(t.blocked))
+			return;
+		dprint("thr %u (%s):\n", thr, name);
+		dump_hist(dprint, "blocked", t.blocked);
+	}
+};
+
+#endif // IPCSTAT_H
@@ -7,15 +7,26 @@
 #ifndef KCONFIG_H
 #define KCONFIG_H
 
+#include "krn-config.h"
+
+#if Cfg_krn_smp  &&  !defined(Cfg_arch_arm)
+#  error "SMP kernel is supported for arm (GIC) only."
+#endif
+
+#if Cfg_krn_smp  &&  Cfg_krn_tickless
+#  error "SMP kernel doesn't support tickless mode."
+#endif
+
 class Kcfg
 {
 public:
 
 	enum
 	{
+		Cpus_max        = Cfg_krn_smp ? Cfg_max_cpus : 1,  // CPUs that run scheduler
 		Ints_max        = 128,  // [0, Ints_max)                               - interrupt threads
-		Kthreads_max    =   1,  // [Ints_max, Ints_max + Kthreads_max)         - kernel threads
-		Thr_num_width   =   8,  // [Ints_max + Kthreads_max, 2^Thr_num_width)  - user threads
+		Kthreads_max    = Cpus_max, // [Ints_max, Ints_max + Kthreads_max)     - kernel threads, idle per CPU
+		Thr_num_width   = Cfg_krn_thrbits,  // [Ints_max + Kthreads_max, 2^Thr_num_width)  - user threads
 		Uthreads_max    = (1 << Thr_num_width) - (Ints_max + Kthreads_max),   // user threads max
 		Threads_max     = Kthreads_max + Uthreads_max,
 
@@ -23,8 +34,31 @@ public:
 		Kip_thrid_user_base   = Ints_max + Kcfg::Kthreads_max,
 		Kip_thrid_number_max  = (1 << Thr_num_width) - 1,
 
-		Timeslice_usec  = 50*1000
+		Timeslice_usec  = 50*1000,
+		Fast_ipc_words  = 8,    // max untyped words for IPC fast path
+		Walk_cache_sz   = 4,    // cached page translations per task for IPC copy
+		Kmem_pages      = Cfg_krn_kmempages  // kernel memory pool, TCBs and kstacks are taken from it
+	};
+
+	// kernel vspace layout, see Aspace::kinit():  kmem (image with kmem pool), kio, kutcbs,
+	// kstacks and kheap regions separated by guard pages
+	enum
+	{
+		Kguard_sz       = Cfg_page_sz,
+		Kimage_sz       = 0x300000,     // kernel code and static data except kmem pool and thread table,
+		                                // it is checked on boot
+		Kthrtab_sz      = Threads_max * sizeof(void*),   // Threads_t table
+		Kmem_sz         = (Kimage_sz + Kmem_pages * Cfg_page_sz + Kthrtab_sz + 0x3fffff) & ~0x3fffff, // 4 MB align
+		Kio_sz          = 0x100000,     // max for uart, intc and timer pages
+		Kutcb_sz        = Cfg_page_sz,  // kernel mapping of thread's utcb
+		Kstack_sz       = Cfg_page_sz,  // kernel stack of thread, is mapped with guard page
+		Kheap_sz        = 0x100000,
+		Kspace_sz       = Kmem_sz + Kio_sz + Threads_max * (Kutcb_sz + Kstack_sz + Kguard_sz) +
+		                  Kheap_sz + 4 * Kguard_sz
 	};
+
+	static_assert(Thr_num_width >= 8  &&  Thr_num_width <= 16, "usr_krn_thrbits must be 8..16");
+	static_assert(!(Kmem_pages & (Kmem_pages - 1)), "usr_krn_kmempages must be power of 2");
 };
 
 #endif // KCONFIG_H
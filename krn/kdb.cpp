@@ -8,6 +8,9 @@
 #include "ktimer.h"
 #include "threads.h"
 #include "log.h"
+#include "ktrace.h"
+#include "kprof.h"
+#include "ipcstat.h"
 #include "libcio.h"
 #include "sys_proc.h"
 
@@ -70,6 +73,14 @@ static int cmd_timer(unsigned argc, char** argv)
 	return 0;
 }
 
+static int cmd_kmem(unsigned argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+	Kmem::stat(dprint);
+	return 0;
+}
+
 static int cmd_threads(unsigned argc, char** argv)
 {
 	(void) argc;
@@ -86,6 +97,97 @@ static int cmd_cpuusage(unsigned argc, char** argv)
 	return 0;
 }
 
+// incomming:  [on|off|reset|bench]
+static int cmd_sched(unsigned argc, char** argv)
+{
+	if (argc == 2  &&  !strcmp(argv[1], "reset"))
+	{
+		Sched_t::next_stat_reset();
+		return 0;
+	}
+	if (argc == 2  &&  (!strcmp(argv[1], "on")  ||  !strcmp(argv[1], "off")))
+	{
+		Sched_t::next_stat(!strcmp(argv[1], "on"));
+		return 0;
+	}
+
+	uint64_t calls  = Sched_t::next_calls();
+	uint64_t cycles = Sched_t::next_cycles();
+	printf(" next() stat:    %s\n", Sched_t::next_stat() ? "on" : "off");
+	printf(" next() calls:   %llu\n", calls);
+	printf(" next() cycles:  %llu\n", cycles);
+	printf(" next() avg:     %llu\n", calls ? cycles / calls : 0);
+
+	if (argc == 2  &&  !strcmp(argv[1], "bench"))
+	{
+		enum { Loops = 100000 };
+		volatile unsigned prio = 0;
+		uint64_t start = Proc::cycles();
+		for (unsigned i=0; i<Loops; ++i)
+			prio = Threads_t::highest_ready_prio();
+		uint64_t bitscan = Proc::cycles() - start;
+		start = Proc::cycles();
+		for (unsigned i=0; i<Loops; ++i)
+			prio = Threads_t::highest_ready_prio_linear();
+		uint64_t linear = Proc::cycles() - start;
+		printf(" prio lookup, cycles per call (max ready prio=%u):\n", prio);
+		printf("   bitscan:  %llu.%02llu\n", bitscan / Loops, bitscan % Loops * 100 / Loops);
+		printf("   linear:   %llu.%02llu\n", linear / Loops, linear % Loops * 100 / Loops);
+	}
+	return 0;
+}
+
+// incomming:  [mask <hex> | clear | <records>]
+static int cmd_ktrace(unsigned argc, char** argv)
+{
+	if (argc == 3  &&  !strcmp(argv[1], "mask"))
+	{
+		Ktrace::mask(strtoul(argv[2], NULL, 16));
+		return 0;
+	}
+	if (argc == 2  &&  !strcmp(argv[1], "clear"))
+	{
+		Ktrace::clear();
+		return 0;
+	}
+	Ktrace::dump(dprint, argc == 2 ? strtoul(argv[1], NULL, 0) : 20);
+	return 0;
+}
+
+// incomming:  [start | stop | <top>]
+static int cmd_kprof(unsigned argc, char** argv)
+{
+	if (argc == 2  &&  !strcmp(argv[1], "start"))
+		Kprof::start();
+	else if (argc == 2  &&  !strcmp(argv[1], "stop"))
+		Kprof::stop();
+	else
+		Kprof::dump(dprint, argc == 2 ? strtoul(argv[1], NULL, 0) : 20);
+	return 0;
+}
+
+// incomming:  [start | stop]
+static int cmd_ipcstat(unsigned argc, char** argv)
+{
+	if (argc == 2  &&  !strcmp(argv[1], "start"))
+		Ipcstat::start();
+	else if (argc == 2  &&  !strcmp(argv[1], "stop"))
+		Ipcstat::stop();
+	else
+	{
+		Ipcstat::dump(dprint);
+		#if Cfg_krn_ipcstat
+		for (unsigned i=Kcfg::Ints_max; i<Kcfg::Ints_max+Kcfg::Threads_max; ++i)
+		{
+			Thread_t* thr = Threads_t::find(i);
+			if (thr)
+				Ipcstat::dump(dprint, thr->ipcstat(), i, thr->name());
+		}
+		#endif
+	}
+	return 0;
+}
+
 // incomming:  [thread_id] [u]
 static int cmd_entry_frame(unsigned argc, char** argv)
 {
@@ -110,7 +212,11 @@ static int cmd_entry_frame(unsigned argc, char** argv)
 	if (thread_id)
 		thr = Threads_t::find(thread_id);
 
-	if (thr)
+	if (thr  &&  !thr->kstack_area())
+	{
+		printf(" Thread %u is not active.\n", thread_id);
+	}
+	else if (thr)
 	{
 		printf(" thread:  name=%s, id=%u:\n", thr->name(), thr->globid().number());
 		thr->entry_frame()->dump(printf, need_print_usr_mem);
@@ -244,8 +350,13 @@ void Kdb::init()
 	_shell.add_cmd("log",           cmd_log);
 	_shell.add_cmd("intc",          cmd_intc);
 	_shell.add_cmd("timer",         cmd_timer);
+	_shell.add_cmd("kmem",          cmd_kmem);
 	_shell.add_cmd("threads",       cmd_threads);
 	_shell.add_cmd("cpuusage",      cmd_cpuusage);
+	_shell.add_cmd("sched",         cmd_sched);
+	_shell.add_cmd("ktrace",        cmd_ktrace);
+	_shell.add_cmd("kprof",         cmd_kprof);
+	_shell.add_cmd("ipcstat",       cmd_ipcstat);
 	_shell.add_cmd("entry_frame",   cmd_entry_frame);
 	_shell.add_cmd("banner",        cmd_banner);
 	_shell.add_cmd("mem",           cmd_show_memory);
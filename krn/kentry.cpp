@@ -11,21 +11,79 @@
 #include "l4_syscalls.h"
 #include "threads.h"
 #include "kuart.h"
+#include "ktrace.h"
+#include "kprof.h"
 #include <assert.h>
 
 void process_pfault(Thread_t* fault_thr, word_t fault_addr, word_t fault_access, word_t fault_inst);
 void process_exception(Thread_t* fault_thr, int exc_type, word_t pfault_addr_and_acc);
 void kdb_console_entry_wrapper(bool krn_mode, bool error_entry, const char* prompt);
 
+// notify handler about interrupt, return handler if it becomes ready
+static Thread_t* notify_irq(Int_thread_t* ithr)
+{
+	Thread_t* dst = Threads_t::find(ithr->handler());
+	assert(dst);
+
+	if (dst->state() != Thread_t::Receive_ipc  ||  !dst->is_irq_acceptable(ithr->intno()))
+	{
+		ithr->pending(true);  // receiver is not ready to ipc
+		return 0;
+	}
+
+	L4_utcb_t* utcb = dst->utcb();
+	L4_msgtag_t tag = utcb->msgtag();
+	tag.proto_label(L4_msgtag_t::Interrupt);
+	tag.proto_nulls();
+	tag.untyped(1);
+	tag.typed(0);
+	utcb->msgtag(tag);
+	utcb->mr[1] = ithr->notify();  // number of coalesced interrupts
+	dst->entry_frame()->scall_ipc_from(ithr->globid().raw());
+	dst->state(Thread_t::Ready);
+	return dst;
+}
+
+// expired holds of interrupt coalescing:  unmask held irq or flush counted interrupts
+static Thread_t* check_int_holds(L4_clock_t now)
+{
+	Thread_t* next = 0;
+	for (unsigned irq=0; irq<Kcfg::Ints_max  &&  Int_thread_t::held(); ++irq)
+	{
+		Int_thread_t* ithr = Threads_t::int_thread(irq);
+		if (!ithr->hold()  ||  ithr->hold() > now)
+			continue;
+		ithr->release();
+		if (ithr->is_counting())
+		{
+			Intc::mask(irq);       // until handler acks notification
+			ithr->eoi_done(true);  // counted interrupts are EOI'd already, ack only unmasks
+			Thread_t* dst = notify_irq(ithr);
+			if (dst  &&  (!next  ||  dst->prio_max() > next->prio_max()))
+				next = dst;
+		}
+		else
+		{
+			Intc::unmask(irq);  // comes at once if device still requests it
+		}
+	}
+	return next;
+}
+
 static void kern_timer_tick()
 {
 	// update system clock
 	SystemClock_t::tick();
 
+	// timer irq comes to one CPU, others account timeslice by ipi
+	Smp::send_ipi_others(Smp::Ipi_tick);
+
 	Thread_t* cur = Sched_t::current();
+	Kprof::sample(cur);
 
 	// update timeslice of current thread
 	L4_clock_t now = SystemClock_t::sys_clock(__func__);
+	SystemClock_t::publish(now);
 	//cur->tmevent_tick(now);  // uncomment to time account
 	cur->timeslice_update(now);
 
@@ -40,15 +98,68 @@ static void kern_timer_tick()
 	Thread_t* next1 = Threads_t::check_ipc_timeouts(now); // may be hi-prio
 	Thread_t* next2 = 0;                                  // same-prio
 
+	Thread_t* ihnd = check_int_holds(now);                // may be hi-prio
+	if (ihnd  &&  (!next1  ||  ihnd->prio_max() > next1->prio_max()))
+		next1 = ihnd;
+
 	if (!cur->timeslice())
 		next2 = *Threads_t::timeslice_expired(cur);
 
+	#if Cfg_krn_tickless
+	// program next timer irq for thread which will run
+	Thread_t* nxt = (next1  &&  next1->prio_max() > cur->prio_max()) ? next1 : next2 ? next2 : cur;
+	Threads_t::tickless_update(nxt, true);
+	#endif
+
 	if (next1  &&  next1->prio_max() > cur->prio_max())
 		Sched_t::switch_to(next1);  // expired timeout for hi-prio thread
 	else if (next2)
 		Sched_t::switch_to(next2);  // expiret timeslice
 }
 
+#if Cfg_krn_smp
+static void kern_ipi(unsigned ipi)
+{
+	Thread_t* cur = Sched_t::current();
+
+	if (ipi == Smp::Ipi_tick)
+	{
+		Kprof::sample(cur);
+		L4_clock_t now = SystemClock_t::sys_clock(__func__);
+		cur->timeslice_update(now);
+		Thread_t* next = Threads_t::check_ipc_timeouts(now);  // timeouts of threads of this CPU
+		if (next  &&  next->prio_max() > cur->prio_max())
+		{
+			Sched_t::switch_to(next);  // expired timeout for hi-prio thread
+			return;
+		}
+		if (!cur->timeslice())
+		{
+			Sched_t::switch_to(*Threads_t::timeslice_expired(cur));  // expired timeslice
+			return;
+		}
+	}
+
+	// migration requested by other CPU
+	if (cur->cpu_migrate() != Thread_t::No_cpu)
+	{
+		Sched_t::migrate(cur, cur->cpu_migrate());
+		return;
+	}
+
+	// new ready threads in queues of this CPU
+	Sched_t::reschedule();
+}
+#endif
+
+// in tickless mode timer irq may be programmed too late for new kernel state
+inline void tickless_point()
+{
+	#if Cfg_krn_tickless
+	Threads_t::tickless_update(Sched_t::current(), false);
+	#endif
+}
+
 inline void preemtion_point()
 {
 	Proc::enable_irq();
@@ -67,8 +178,10 @@ inline void check_force_exception()
 
 void kentry_pagefault(word_t fault_addr, word_t fault_access, word_t fault_inst)
 {
+	Ktrace::log(L4_ktrace_pf, Sched_t::current()->globid().number(), fault_addr, fault_inst);
 	process_pfault(Sched_t::current(), fault_addr, fault_access, fault_inst);
 	check_force_exception();
+	tickless_point();
 	//preemtion_point();
 }
 
@@ -122,7 +235,7 @@ void kentry_syscall()
 		}
 		case L4_syscall_system_clock:
 		{
-			// TODO:  now syscall duration 4-5 usec, do in ASM and compare duration
+			// NOTE:  syscall duration 4-5 usec, user reads kip clock data if it is calibrated
 			L4_clock_t clock = SystemClock_t::sys_clock(__func__);
 			eframe->scall_sclock(clock);
 			break;
@@ -144,7 +257,7 @@ void kentry_syscall()
 		}
 		case L4_syscall_lipc:
 		{
-			panic("Unsupported syscall:  lipc.\n");
+			syscall_lipc(*cur, *eframe);
 			break;
 		}
 		case L4_syscall_unmap:
@@ -196,6 +309,7 @@ void kentry_syscall()
 		}
 	}
 	check_force_exception();
+	tickless_point();
 	//preemtion_point();
 }
 
@@ -205,6 +319,17 @@ void kentry_irq(unsigned irq)
 	Entry_frame_t* eframe = cur->entry_frame();
 	//eframe->dump(printf, false);
 	(void)eframe;
+	Ktrace::log(L4_ktrace_irq_entry, cur->globid().number(), irq);
+
+	#if Cfg_krn_smp
+	if (Smp::is_ipi(irq))
+	{
+		kern_ipi(irq);  // eoi is done by arch entry
+		check_force_exception();
+		Ktrace::log(L4_ktrace_irq_exit, cur->globid().number(), irq);
+		return;
+	}
+	#endif
 
 	Intc::clear(irq);
 	if (irq == Cfg_krn_timer_irq)
@@ -221,30 +346,27 @@ void kentry_irq(unsigned irq)
 		Intc::mask(irq);  // disable interrupt until it be re-enables by re-enable msg
 		Int_thread_t* ithr = Threads_t::int_thread(irq);
 		assert(ithr);
-		L4_thrid_t h = ithr->handler();
-		assert(!h.is_nil());
-		Thread_t* dst = Threads_t::find(h);
-		assert(dst);
-
-		if (dst->state() == Thread_t::Receive_ipc  &&  dst->is_irq_acceptable(irq))
-		{
-			L4_utcb_t* utcb = dst->utcb();
-			utcb->msgtag().proto_label(L4_msgtag_t::Interrupt);
-			utcb->msgtag().proto_nulls();
-			utcb->msgtag().untyped(0);
-			utcb->msgtag().typed(0);
-			dst->entry_frame()->scall_ipc_from(thrid_int(irq).raw());
-			dst->state(Thread_t::Ready);
-			if (dst->prio_max() > Sched_t::current()->prio_max())
+		assert(ithr->is_active());
+
+		if (ithr->event())
+		{
+			ithr->eoi_done(false);  // handler's ack does EOI
+			// direct switch to handler with higher prio
+			Thread_t* dst = notify_irq(ithr);
+			if (dst  &&  dst->prio_max() > Sched_t::current()->prio_max())
 				Sched_t::switch_to(dst);
 		}
-		else // receiver is not ready to ipc
+		else
 		{
-			ithr->pending(true);
+			// coalescing of edge irq:  kernel acks it, handler gets number of interrupts later
+			Intc::eoi(irq);
+			Intc::unmask(irq);
 		}
 	}
 
 	check_force_exception();
+	tickless_point();
+	Ktrace::log(L4_ktrace_irq_exit, cur->globid().number(), irq);
 	//preemtion_point();
 }
 
@@ -60,6 +60,26 @@ public:
 		wassert(_addr != -1);
 		return intc_irq(_addr);
 	}
+
+	static inline void init_cpu()
+	{
+		wassert(_addr != -1);
+		intc_init_cpu(_addr);
+	}
+
+	static inline void send_sgi(unsigned irq, unsigned cpu_mask)
+	{
+		wassert(_addr != -1);
+		int rc = intc_send_sgi(_addr, irq, cpu_mask);
+		(void) rc;
+		wassert(!rc && "intc_send_sgi() failed");
+	}
+
+	static inline void eoi_ack(unsigned ack)
+	{
+		wassert(_addr != -1);
+		intc_eoi_ack(_addr, ack);
+	}
 	#endif
 
 	static inline void eoi(unsigned irq)
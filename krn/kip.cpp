@@ -15,10 +15,7 @@ static L4_kip_t kip __attribute__((section(".kip"))) =
 	0, 0, 0, 0,
 	0, 0, 0, 0,
 	0, 0, 0, 0,
-	0, 0, 0, 0,
-	0, 0, 0, 0,
-	0, 0, 0, 0,
-	0, 0, 0, 0,
+	{ 0, 0, 0, 0, 0 }, { 0 },  // clock, padding_2
 	0, 0, 0, 0,
 	0, 0, 0, 0,
 	0, 0, 0, 0,
@@ -13,9 +13,11 @@
 #include <stdarg.h>
 #include "wlibc_panic.h"
 #include "ptable.h"
+#include "slab.h"
 #include "kconfig.h"
 #include "list.h"
 #include "wlibc_assert.h"
+#include "ksmp.h"
 
 /*
 static void dprint_list(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
@@ -391,7 +393,8 @@ private:
 	static aspace_t _kspace;         // kernel virt space, common for all contexts
 	static ranges_t _ranges;         // virtual space regions
 	static psize_t  _diff_kva_kpa;   // difference between kernel virt and phys addresses
-	static unsigned _cur_mmu_ctxid;  // optimisation:  don't set mm_ctx if switching to ctx=0 (idle)
+	static unsigned _cur_mmu_ctxid[Kcfg::Cpus_max];  // optimisation:  don't set mm_ctx if switching to ctx=0 (idle)
+	static addr_t   _copy_win[Kcfg::Cpus_max];       // per-CPU kernel page to access phys memory
 
 	// individual addr space data
 	Pgtab    _pgtab;                 // root page table
@@ -486,23 +489,28 @@ public:
 
 		enum
 		{
-			Guard = Cfg_page_sz,  // guard page between regions
-			Kstack_max = 2 * Cfg_page_sz,
+			Guard = Kcfg::Kguard_sz,  // guard page between regions
 
 			Usr_va     = 0x10000000,                         // all vspace from 0x10000000 till Cfg_krn_vaddr
 			Usr_sz     = Cfg_krn_vaddr - Usr_va - Guard,     //
 			Kmem_va    = Cfg_krn_vaddr,                      //
-			Kmem_sz    = 0x400000,                           // 4 MB, may be bigger if need
+			Kmem_sz    = Kcfg::Kmem_sz,                      // kernel image with kmem pool
 			Kio_va     = Kmem_va + Kmem_sz + Guard,          //
 			Kio_sz     = Kio_uart_pg_sz + Kio_intc_pg_sz + Kio_timer_pg_sz + 2*Guard,
 			Kutcbs_va  = Kio_va + Kio_sz + Guard,            // area to map utcb in kernel space
-			Kutcbs_sz  = Kcfg::Threads_max * Cfg_page_sz,    //
+			Kutcbs_sz  = Kcfg::Threads_max * Kcfg::Kutcb_sz, //
 			Kstacks_va = Kutcbs_va + Kutcbs_sz + Guard,      // kernel stacks area
-			Kstacks_sz = Kcfg::Threads_max * (Kstack_max + Guard),  //
+			Kstacks_sz = Kcfg::Threads_max * (Kcfg::Kstack_sz + Guard),  //
 			Kheap_va   = Kstacks_va + Kstacks_sz + Guard,    // kernel heap area
-			Kheap_sz   = 0x100000                            //
+			Kheap_sz   = Kcfg::Kheap_sz                      //
 		};
 
+		static_assert((size_t)Kio_sz <= (size_t)Kcfg::Kio_sz, "increase Kcfg::Kio_sz");
+
+		extern int _bss_end;  // linker var
+		if ((addr_t)&_bss_end - Kmem_va > Kmem_sz)
+			panic("Kernel image is bigger than Kcfg::Kmem_sz, increase Kcfg::Kimage_sz.");
+
 		_ranges.usr.set(Usr_va, Usr_sz, "usr");
 		_ranges.kmem.set(Kmem_va, Kmem_sz, "kmem");
 		_ranges.kio.set(Kio_va, Kio_sz, "kio");
@@ -513,6 +521,16 @@ public:
 		setup_kdiff();
 		Pgtab::kinit();
 		setup_kernel_map();
+
+		// reserve copy windows, pages are mapped on use
+		for (unsigned i=0; i<Kcfg::Cpus_max; ++i)
+			_copy_win[i] = alloc_kspace(Cfg_page_sz);
+	}
+
+	// is [va, va+sz) inside user part of vspace
+	static bool is_user_range(addr_t va, size_t sz)
+	{
+		return va + sz >= va  &&  _ranges.usr.inside(va, sz);
 	}
 
 	static addr_t kuart_pg_va()  { return _ranges.kio.start; }
@@ -572,17 +590,17 @@ public:
 	inline void set_current(bool force = false)
 	{
 		// optimize switching from/to idle
-		bool need_set = _id != 0  &&  _id != _cur_mmu_ctxid; // not idle and not cur
+		bool need_set = _id != 0  &&  _id != _cur_mmu_ctxid[Smp::cpu()]; // not idle and not cur
 		if (force || need_set)
 		{
 			_pgtab.set_current();
-			_cur_mmu_ctxid = _id;
+			_cur_mmu_ctxid[Smp::cpu()] = _id;
 		}
 	};
 
 	inline bool is_cur_aspace()
 	{
-		return _cur_mmu_ctxid == _id;
+		return _cur_mmu_ctxid[Smp::cpu()] == _id;
 	}
 
 private:
@@ -667,24 +685,40 @@ public:
 		printk("Aspace::%s:  pa=0x%llx, sz=0x%zx.\n", __func__, (long long)pa, sz);
 		wassert(is_aligned(pa, Cfg_page_sz));
 		wassert(is_aligned(sz, Cfg_page_sz));
-		wassert(sz <= 0x2000); // FIXME
-		wassert(sz);
+		wassert(sz == Kcfg::Kstack_sz);
 		wassert(pa);
 
 		printk("Aspace::%s:  region:  0x%lx .. 0x%lx.\n", __func__,
 			_ranges.kstacks.start, _ranges.kstacks.start + _ranges.kstacks.sz);
 
-		addr_t kva = _kspace.alloc(sz + 0x1000/*Guard FIXME*/, Cfg_page_sz, Type(Acc_kdata, Cachable), aspace_t::NotCombine,
+		addr_t kva = _kspace.alloc(sz + Kcfg::Kguard_sz, Cfg_page_sz, Type(Acc_kdata, Cachable), aspace_t::NotCombine,
 		                           _ranges.kstacks.start, _ranges.kstacks.sz);
 		if (!kva)
 			kdump();
 		wassert(kva && "no kernel memory");
 		printk("Aspace::%s:  pa=0x%llx --> kstack=%lx.\n", __func__, (long long)pa, kva);
 		if (kva)
-			Pgtab::kmap(kva, pa, Cfg_page_sz, acc2mmuacc(Acc_kdata), Cachable);
+			Pgtab::kmap(kva, pa, sz, acc2mmuacc(Acc_kdata), Cachable);
 		return kva;
 	}
 
+	static void kunmap_kstack(addr_t va, size_t sz)
+	{
+		printk("Aspace::%s:  va=0x%lx, sz=0x%zx.\n", __func__, va, sz);
+		wassert(_ranges.kstacks.inside(va, sz));
+		_kspace.free(va, sz + Kcfg::Kguard_sz);
+		Pgtab::kunmap(va, sz);
+	}
+
+	// map phys page to copy window of current CPU, return kernel va for pa;
+	// window is valid till the next call on this CPU
+	static inline addr_t kmap_copy_win(paddr_t pa, kacc_t acc)
+	{
+		addr_t kva = _copy_win[Smp::cpu()];
+		Pgtab::kremap_page(kva, round_pg_down(pa), acc2mmuacc(acc), Cachable);
+		return kva + get_pg_offset(pa);
+	}
+
 	static addr_t alloc_kspace(size_t sz)
 	{
 		printk("Aspace::%s:  sz=0x%zx.\n", __func__, sz);
@@ -749,6 +783,8 @@ public:
 
 		Type type = _uspace.insert(va, sz, Type(acc, cachable == Cachable), aspace_t::Combine);
 		_pgtab.map(va, pa, sz, acc2mmuacc(type.acc), cachable);
+		if (is_cur_aspace())
+			_pgtab.tlb_sync();
 	}
 
 	// va may be 0
@@ -763,6 +799,8 @@ public:
 
 		_uspace.free(va, sz);
 		_pgtab.unmap(va, sz);
+		if (is_cur_aspace())
+			_pgtab.tlb_sync();
 	}
 
 	paddr_t walk(addr_t va, size_t sz)
@@ -830,59 +868,127 @@ public:
 };
 
 //--------------------------------------------------------------------------------------------------
-// Kernel memory poll.
+// Kernel memory pool.
+// Pages are managed by buddy allocator, block of 2^order pages is aligned to its size inside
+// the pool. Chanks up to half of page are taken from size-class slab caches. Per-page tag keeps
+// order of busy block or marks slab page, so free() does not need size.
+static constexpr unsigned kmem_order(unsigned pages) { return pages > 1 ? 1 + kmem_order(pages / 2) : 0; }
+
 class Kmem
 {
 public:
 
-	struct Type
-	{
-		enum type_t
-		{
-			Free,
-			Busy
-		};
-		type_t type;
-		explicit Type(type_t t) : type(t) {}
-		inline bool operator == (const Type& t) const { return type == t.type; }
-		inline bool operator != (const Type& t) const { return !operator==(t); }
-		inline Type operator |= (const Type& t) { type = (type_t)(type | t.type);  return *this; }
-		const char* str() const
-		{
-			switch (type)
-			{
-				case Free:       return "free";
-				case Busy:       return "busy";
-			}
-			wassert(0);
-			return "__err__";
-		}
-	};
+	typedef Slab_t::Print_t Print_t;
 
 private:
 
 	enum
 	{
-		Alloc_min_sz = 0x40,              // minumum allocated mem chank
-		Pool_init_sz = 256 * Cfg_page_sz  // initial pool size
+		Alloc_min_sz  = 0x40,                       // minumum allocated mem chank
+		Pool_pages    = Kcfg::Kmem_pages,           // power of 2, usr_krn_kmempages
+		Pool_init_sz  = Pool_pages * Cfg_page_sz,   // initial pool size
+		Pool_align    = 16 * Cfg_page_sz,           // max alignment of allocated chank
+		Order_max     = kmem_order(Pool_pages),     // log2(Pool_pages)
+		Caches        = 6,                          // size classes 64 .. 2048 bytes
+		Pg_free       = 0x80,                       // page tag:  head of free block | order
+		Pg_busy       = 0x40,                       // page tag:  head of busy block | order
+		Pg_slab       = 0x20,                       // page tag:  slab page, owner in _pg_slab[]
+		Pg_order_mask = 0x0f
+	};
+
+	static_assert((1 << Order_max) == Pool_pages);
+	static_assert(Order_max <= Pg_order_mask);
+	static_assert((Alloc_min_sz << (Caches - 1)) == Cfg_page_sz / 2);
+
+	// header of free block
+	struct Block_t
+	{
+		Block_t* next;
+		Block_t* prev;
 	};
 
-	typedef Address_space_t <addr_t, size_t, Type, 1024> memory_t;
-	static memory_t memory;                       // kernel memory pool
-	static uint8_t premapped_mem [Pool_init_sz];  // premapped memory
-	static size_t pool_sz;
+	static uint8_t  premapped_mem [Pool_init_sz] __attribute__((aligned(Pool_align)));  // premapped memory
+	static uint8_t  _pg_tag [Pool_pages];          // Pg_* tags
+	static Slab_t*  _pg_slab [Pool_pages];         // owner of slab page
+	static Block_t* _blocks [Order_max + 1];       // lists of free blocks
+	static unsigned _nblocks [Order_max + 1];      //
+	static Slab_t   _caches [Caches];              // size classes
+	static size_t   pool_sz;                       // free bytes
+	static size_t   pool_min;                      // low-water mark of free bytes
 
 private:
 
-	static void setup_premapped()
+	static inline unsigned pg_idx(addr_t va) { return (va - (addr_t)premapped_mem) / Cfg_page_sz; }
+	static inline addr_t   pg_va(unsigned i) { return (addr_t)premapped_mem + i * Cfg_page_sz; }
+
+	static void block_push(unsigned idx, unsigned order)
 	{
-		addr_t va = (addr_t)premapped_mem;
-		size_t sz = sizeof(premapped_mem);
+		Block_t* b = (Block_t*) pg_va(idx);
+		b->prev = 0;
+		b->next = _blocks[order];
+		if (b->next)
+			b->next->prev = b;
+		_blocks[order] = b;
+		_nblocks[order]++;
+		_pg_tag[idx] = Pg_free | order;
+	}
 
-		wassert(va && is_aligned(va, Cfg_page_sz));
-		wassert(sz && is_aligned(sz, Cfg_page_sz));
+	static void block_remove(unsigned idx, unsigned order)
+	{
+		Block_t* b = (Block_t*) pg_va(idx);
+		if (b->prev)
+			b->prev->next = b->next;
+		else
+			_blocks[order] = b->next;
+		if (b->next)
+			b->next->prev = b->prev;
+		_nblocks[order]--;
+		_pg_tag[idx] = 0;
+	}
+
+	// take the smallest suitable block and split it, return index of first page
+	static unsigned block_alloc(unsigned order)
+	{
+		unsigned o = order;
+		while (o <= Order_max  &&  !_blocks[o])
+			o++;
+		if (o > Order_max)
+		{
+			dump();
+			panic("No free kernel memory.\n");
+		}
 
-		memory.add(va, sz, Type(Type::Free), memory_t::NotCombine);
+		unsigned idx = pg_idx((addr_t)_blocks[o]);
+		block_remove(idx, o);
+		while (o > order)
+		{
+			o--;
+			block_push(idx + (1 << o), o);  // upper half
+		}
+		_pg_tag[idx] = Pg_busy | order;
+		pool_sz -= Cfg_page_sz << order;
+		pool_min = min(pool_min, pool_sz);
+		return idx;
+	}
+
+	// return block and merge it with free buddies
+	static void block_free(unsigned idx)
+	{
+		wassert((_pg_tag[idx] & ~Pg_order_mask) == Pg_busy);
+		unsigned order = _pg_tag[idx] & Pg_order_mask;
+		_pg_tag[idx] = 0;
+		pool_sz += Cfg_page_sz << order;
+
+		while (order < Order_max)
+		{
+			unsigned buddy = idx ^ (1 << order);
+			if (_pg_tag[buddy] != (Pg_free | order))
+				break;
+			block_remove(buddy, order);
+			idx = min(idx, buddy);
+			order++;
+		}
+		block_push(idx, order);
 	}
 
 public:
@@ -890,14 +996,40 @@ public:
 	static void init()
 	{
 		printk("Kmem::%s:  hello.\n", __func__);
-		setup_premapped();       // now Pgtab is able to alloc mem from Kmem
+
+		wassert(is_aligned((addr_t)premapped_mem, Pool_align));
+
+		pool_min = pool_sz;
+		block_push(0, Order_max);  // now Pgtab is able to alloc mem from Kmem
 	}
 
 	static void dump()
 	{
-		printk("Dump kmemory pool (%zu/%zu), free=0x%zx bytes:\n", memory.size(), memory.capacity(), pool_sz);
-		for (memory_t::citer_t it=memory.cbegin(); it!=memory.cend(); ++it)
-			printk("  [%08lx - %08lx)  sz=0x%08zx,  %s.\n", it->addr, it->addr + it->sz, it->sz, it->type.str());
+		printk("Dump kmemory pool [%08lx - %08lx), free=0x%zx bytes, min free=0x%zx bytes:\n",
+			(addr_t)premapped_mem, (addr_t)premapped_mem + Pool_init_sz, pool_sz, pool_min);
+		for (unsigned o=0; o<=Order_max; ++o)
+			printk("  order=%u:  %u free blocks.\n", o, _nblocks[o]);
+	}
+
+	// kdb statistics of buddy pool and slab caches
+	static void stat(Print_t dprint)
+	{
+		dprint("pool:  %u pages, free=%zu, used=%zu, used hwm=%zu.\n", Pool_pages,
+			pool_sz / Cfg_page_sz, (Pool_init_sz - pool_sz) / Cfg_page_sz, (Pool_init_sz - pool_min) / Cfg_page_sz);
+		dprint("free blocks:");
+		for (unsigned o=0; o<=Order_max; ++o)
+			dprint(" %u", _nblocks[o]);
+		dprint("  (order 0..%u)\n", Order_max);
+		Slab_t::dump(dprint);
+	}
+
+	// page for slab cache
+	static addr_t alloc_slab_page(Slab_t* slab)
+	{
+		unsigned idx = block_alloc(0);
+		_pg_tag[idx] = Pg_slab;
+		_pg_slab[idx] = slab;
+		return pg_va(idx);
 	}
 
 	// allocate aligned memory chank
@@ -905,30 +1037,27 @@ public:
 	{
 		printk("Kmem::%s:  sz=0x%zx, align=0x%lx, pool_sz=0x%zx.\n", __func__, sz, align, pool_sz);
 
-		wassert(sz && align);
+		wassert(sz && align && align <= Pool_align);
 
-		sz = round_up(sz, Alloc_min_sz);
-
-		// find free memory
-		memory_t::iter_t it = memory.begin();
-		for ( ; it!=memory.end(); ++it)
+		// objects in slab and buddy blocks are aligned to their size
+		size_t chank = max(sz, align);
+		if (chank <= Cfg_page_sz / 2)
 		{
-			if (it->type.type == Type::Free  &&  it->sz >= sz)
-			{
-				addr_t aaddr = round_up(it->addr, align);  // aligned addr
-				size_t diff = aaddr - it->addr;
-				if (it->sz >= diff + sz)
-				{
-					memory.set_type(it, aaddr, sz, Type(Type::Busy), memory_t::NotCombine); // inside 'it' may be changed
-					pool_sz -= sz;
-					return aaddr;
-				}
-			}
+			unsigned i = 0;
+			while ((size_t)(Alloc_min_sz << i) < chank)
+				i++;
+			return (addr_t) _caches[i].alloc();
 		}
 
-		dump();
-		panic("No free kernel memory.\n");
-		return 0;
+		unsigned order = 0;
+		while ((size_t)(Cfg_page_sz << order) < chank)
+			order++;
+		if (order > Order_max)
+		{
+			dump();
+			panic("No free kernel memory.\n");
+		}
+		return pg_va(block_alloc(order));
 	}
 
 	// free previously allocated memory
@@ -936,10 +1065,15 @@ public:
 	{
 		printk("Kmem::%s:  va=%lx.\n", __func__, va);
 
-		memory_t::iter_t it = memory.find(va);
-		wassert(it != memory.end()  &&  it->type.type == Type::Busy);
-		pool_sz += it->sz;
-		memory.set_type(it, va, it->sz, Type(Type::Free), memory_t::Combine);
+		wassert(va >= (addr_t)premapped_mem  &&  va < (addr_t)premapped_mem + Pool_init_sz);
+		unsigned idx = pg_idx(va);
+		if (_pg_tag[idx] == Pg_slab)
+		{
+			_pg_slab[idx]->free((void*)va);
+			return;
+		}
+		wassert(is_aligned(va, Cfg_page_sz));
+		block_free(idx);
 	}
 };
 
@@ -950,6 +1084,7 @@ inline paddr_t kmem_paddr(addr_t va, size_t sz)    { return Aspace::kmem_paddr(v
 inline void*   kmem_vaddr(paddr_t pa, size_t sz)   { return (void*)Aspace::kmem_vaddr(pa, sz); }
 inline addr_t  kmem_alloc(size_t sz, addr_t align) { return Kmem::alloc(sz, align); }
 inline void    kmem_free(void* va)                 { Kmem::free((addr_t)va); }
+inline addr_t  kmem_slab_page(Slab_t* slab)       { return Kmem::alloc_slab_page(slab); }
 inline addr_t  kuart_va()                          { return Aspace::kuart_pg_va(); }
 inline addr_t  kintc_va()                          { return Aspace::kintc_pg_va(); }
 inline addr_t  ktimer_va()                         { return Aspace::ktimer_pg_va(); }
@@ -0,0 +1,164 @@
+//##################################################################################################
+//
+//  Kprof - statistical sampling profiler driven by kernel timer tick.
+//
+//##################################################################################################
+
+#ifndef KPROF_H
+#define KPROF_H
+
+#include "kconfig.h"
+#include "ksmp.h"
+#include "threads.h"
+#include "thrid.h"
+#include "l4_kdbops.h"
+
+// Every timer tick (and tick ipi on other CPUs) takes sample of interrupted thread. Kernel code
+// runs with disabled irqs except idle loop, so kernel samples are idle samples. Buffer isn't
+// overwritten, ticks after it is full are counted as lost. usr_krn_kprof=0 removes profiler.
+class Kprof
+{
+public:
+
+	typedef void (*Print_t)(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+private:
+
+	static unsigned _cnt;   // taken samples
+	static unsigned _lost;  // ticks with full buffer
+	static bool     _on;
+
+	#if Cfg_krn_kprof
+	enum { Samples_max = Cfg_krn_kprof };
+
+	static L4_kprof_sample_t _samples[Samples_max];
+	static L4_kprof_sample_t _sorted[Samples_max];  // copy of samples sorted for dump
+
+	// order by thread and pc to count the same samples
+	static inline bool less(const L4_kprof_sample_t& a, const L4_kprof_sample_t& b)
+	{
+		return a.thrid < b.thrid  ||  (a.thrid == b.thrid  &&  a.pc < b.pc);
+	}
+
+	static void sort(L4_kprof_sample_t* arr, unsigned cnt)
+	{
+		// shell sort, done in kdb only
+		for (unsigned gap=cnt/2; gap; gap/=2)
+			for (unsigned i=gap; i<cnt; ++i)
+			{
+				L4_kprof_sample_t s = arr[i];
+				unsigned j = i;
+				for ( ; j>=gap  &&  less(s, arr[j-gap]); j-=gap)
+					arr[j] = arr[j-gap];
+				arr[j] = s;
+			}
+	}
+	#endif
+
+public:
+
+	static inline void sample(Thread_t* cur)
+	{
+		#if Cfg_krn_kprof
+		if (!_on)
+			return;
+		if (_cnt == Samples_max)
+		{
+			_lost++;
+			return;
+		}
+		L4_kprof_sample_t& s = _samples[_cnt++];
+		bool krn = !thrid_is_global_user(cur->globid());
+		s.pc    = krn ? 0 : cur->entry_frame()->entry_pc();
+		s.thrid = cur->globid().number();
+		s.cpu   = Smp::cpu();
+		s.flags = krn ? L4_kprof_sample_t::Kernel : 0;
+		#else
+		(void) cur;
+		#endif
+	}
+
+	static void start()
+	{
+		_cnt = 0;
+		_lost = 0;
+		_on = Cfg_krn_kprof;
+	}
+
+	static void stop()
+	{
+		_on = false;
+	}
+
+	// copy samples to user buffer of current task, return number of samples or -1 for wrong buffer
+	static int read(Task_t* task, addr_t buf, unsigned sz)
+	{
+		#if Cfg_krn_kprof
+		unsigned n = min(sz, _cnt);
+		return task->copy_to_user(buf, _samples, n * sizeof(L4_kprof_sample_t))  ?  (int)n  :  -1;
+		#else
+		(void) task;
+		(void) buf;
+		(void) sz;
+		return 0;
+		#endif
+	}
+
+	// print samples count and 'top' most frequent thread:pc pairs, samples are sorted in copy
+	static void dump(Print_t dprint, unsigned top)
+	{
+		dprint("state:  %s, samples:  %u, lost:  %u, max:  %u.\n",
+			_on ? "on" : "off", _cnt, _lost, Cfg_krn_kprof);
+		#if Cfg_krn_kprof
+		if (!_cnt)
+			return;
+
+		unsigned total = _cnt;
+		memcpy(_sorted, _samples, total * sizeof(L4_kprof_sample_t));
+		sort(_sorted, total);
+		dprint("%6s  %6s  %5s  %-8s  %s\n", "count", "%", "thr", "name", "pc");
+
+		// select next greater run of equal samples less than previous one
+		unsigned prev_cnt = -1;
+		unsigned prev_idx = -1;
+		for (unsigned n=0; n<top; )
+		{
+			unsigned best_cnt = 0;
+			unsigned best_idx = 0;
+			for (unsigned i=0; i<total; )
+			{
+				unsigned j = i + 1;
+				while (j < total  &&  !less(_sorted[i], _sorted[j]))
+					j++;
+				unsigned cnt = j - i;
+				bool after_prev = cnt < prev_cnt  ||  (cnt == prev_cnt  &&  i > prev_idx);
+				if (after_prev  &&  cnt > best_cnt)
+				{
+					best_cnt = cnt;
+					best_idx = i;
+				}
+				i = j;
+			}
+			if (!best_cnt)
+				break;
+
+			const L4_kprof_sample_t& s = _sorted[best_idx];
+			Thread_t* thr = Threads_t::find(s.thrid);
+			unsigned promile = 1000 * best_cnt / total;
+			if (s.flags & L4_kprof_sample_t::Kernel)
+				dprint("%6u  %3u.%u  %5u  %-8s  kernel\n", best_cnt, promile/10, promile%10, s.thrid,
+					thr ? thr->name() : "-");
+			else
+				dprint("%6u  %3u.%u  %5u  %-8s  0x%lx\n", best_cnt, promile/10, promile%10, s.thrid,
+					thr ? thr->name() : "-", (long)s.pc);
+			prev_cnt = best_cnt;
+			prev_idx = best_idx;
+			n++;
+		}
+		#else
+		(void) top;
+		#endif
+	}
+};
+
+#endif // KPROF_H
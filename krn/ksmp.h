@@ -0,0 +1,95 @@
+//##################################################################################################
+//
+//  Smp - CPUs data and big kernel lock for SMP kernel.
+//
+//##################################################################################################
+
+#ifndef KSMP_H
+#define KSMP_H
+
+#include "kconfig.h"
+#include "kintc.h"
+#include "sys_proc.h"
+
+// Kernel works under big kernel lock (BKL):  CPU takes it on every kernel entry and releases
+// on return to user mode or in idle loop. Every CPU has own current thread and ready queues,
+// other CPUs are notified about their new ready threads by IPI (SGI for arm).
+class Smp
+{
+	static volatile long     _bkl;     // big kernel lock, 0 - free
+	static volatile unsigned _online;  // bit per CPU that runs scheduler
+
+public:
+
+	enum
+	{
+		Ipi_resched = 0,  // new ready thread or migration request for target CPU
+		Ipi_tick    = 1,  // timer tick, timer irq is processed by one CPU only
+		Ipi_max     = 16  // SGI numbers
+	};
+
+	static inline unsigned cpu()
+	{
+		return Kcfg::Cpus_max > 1  ?  Proc::cpuid()  :  0;
+	}
+
+	static inline void lock()
+	{
+		#if Cfg_krn_smp
+		while (__atomic_exchange_n(&_bkl, 1, __ATOMIC_ACQUIRE))
+			Proc::wait_event();
+		#endif
+	}
+
+	// NOTE:  it is used before stack frames are ready (Thread_t::user_invoke()), don't use stack
+	static inline void unlock()
+	{
+		#if Cfg_krn_smp
+		__atomic_store_n(&_bkl, 0, __ATOMIC_RELEASE);
+		Proc::wmb();
+		Proc::send_event();
+		#endif
+	}
+
+	static inline void online(unsigned cpu)
+	{
+		_online |= 1 << cpu;
+	}
+
+	static inline bool is_online(unsigned cpu)
+	{
+		return cpu < Kcfg::Cpus_max  &&  ((_online >> cpu) & 1);
+	}
+
+	static inline bool is_ipi(unsigned irq)
+	{
+		return Cfg_krn_smp  &&  irq < Ipi_max;
+	}
+
+	static inline void send_ipi(unsigned cpu, unsigned ipi)
+	{
+		#if Cfg_krn_smp
+		Proc::wmb();
+		Intc::send_sgi(ipi, 1 << cpu);
+		#else
+		(void) cpu;
+		(void) ipi;
+		#endif
+	}
+
+	static inline void send_ipi_others(unsigned ipi)
+	{
+		#if Cfg_krn_smp
+		unsigned mask = _online & ~(1 << cpu());
+		if (mask)
+		{
+			Proc::wmb();
+			Intc::send_sgi(ipi, mask);
+		}
+		#else
+		(void) ipi;
+		#endif
+	}
+};
+
+#endif // KSMP_H
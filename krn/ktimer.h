@@ -16,6 +16,15 @@ class Timer
 	static addr_t   _addr;         // device base address
 	static unsigned _sysclock_hz;  // system clock
 	static unsigned _period_usec;  // current reload value
+	static unsigned _cnt_hz;       // free-running counter frequency
+	static uint64_t _cnt_last;     // last read value of free-running counter
+	static uint64_t _cnt_ticks;    // ticks of free-running counter since counter_start()
+
+	static inline uint64_t cnt_ticks_to_usec(uint64_t ticks)
+	{
+		enum { Usec_per_sec = 1000*1000 };
+		return ticks / _cnt_hz * Usec_per_sec + ticks % _cnt_hz * Usec_per_sec / _cnt_hz;
+	}
 
 public:
 
@@ -46,6 +55,17 @@ public:
 		return timer_set(_addr, _sysclock_hz, period_usec);
 	}
 
+	static inline unsigned period_usec()
+	{
+		return _period_usec;
+	}
+
+	static inline unsigned max_period_usec()
+	{
+		wassert(_addr != -1);
+		return timer_max_period_usec(_addr, _sysclock_hz);
+	}
+
 	static inline void start()
 	{
 		wassert(_addr != -1);
@@ -58,6 +78,37 @@ public:
 		timer_stop(_addr);
 	}
 
+	// start free-running counter, it is time base for tickless mode and isn't reset by set()
+	static inline int counter_start()
+	{
+		wassert(_addr != -1);
+		int rc = timer_counter_start(_addr, _sysclock_hz);
+		_cnt_hz = timer_counter_hz(_addr, _sysclock_hz);
+		_cnt_last = timer_counter(_addr);
+		_cnt_ticks = 0;
+		return rc;
+	}
+
+	// usec since counter_start(), hardware counter is extended to 64 bits by software,
+	// so it must be read at least once per counter wrap
+	static inline uint64_t counter_usec()
+	{
+		wassert(_cnt_hz);
+		uint64_t cnt = timer_counter(_addr);
+		_cnt_ticks += (cnt - _cnt_last) & timer_counter_mask(_addr);
+		_cnt_last = cnt;
+		return cnt_ticks_to_usec(_cnt_ticks);
+	}
+
+	// max period for set() which keeps counter_usec() read in time by timer irq
+	static inline unsigned counter_max_period_usec()
+	{
+		wassert(_cnt_hz);
+		uint64_t usec = cnt_ticks_to_usec(timer_counter_mask(_addr) / 2);
+		unsigned max_usec = max_period_usec();
+		return usec < max_usec  ?  usec  :  max_usec;
+	}
+
 	static inline uint64_t value_usec()
 	{
 		wassert(_addr != -1);
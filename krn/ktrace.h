@@ -0,0 +1,132 @@
+//##################################################################################################
+//
+//  Ktrace - binary kernel event trace, per-CPU rings of fixed size records.
+//
+//##################################################################################################
+
+#ifndef KTRACE_H
+#define KTRACE_H
+
+#include "kconfig.h"
+#include "ksmp.h"
+#include "sys_proc.h"
+#include "sys_utils.h"
+#include "l4_ktrace.h"
+
+// Every CPU writes only own ring with disabled irqs, so writer needs no locks. Records are
+// published for readers on other CPUs by release store of wp. Disabled event costs one test
+// of class mask, usr_krn_ktrace=0 removes trace from kernel.
+// Records fill usr_krn_ktrace pages, their number is power of 2 to index ring by mask,
+// header takes one more page.
+class Ktrace
+{
+public:
+
+	typedef void (*Print_t)(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+	enum
+	{
+		Ring_pages = Cfg_krn_ktrace,
+		Ring_sz    = Ring_pages * Cfg_page_sz,
+		Ring_recs  = Ring_pages ? Ring_sz / sizeof(L4_ktrace_rec_t) : 1
+	};
+
+	static_assert(!(Ring_recs & (Ring_recs - 1)), "ktrace:  usr_krn_ktrace must be power of 2");
+
+private:
+
+	struct Ring_t
+	{
+		L4_ktrace_hdr_t hdr;
+		L4_ktrace_rec_t rec[Ring_recs];
+	} __attribute__((aligned(Cfg_page_sz)));
+
+	#if Cfg_krn_ktrace
+	static Ring_t _rings[Kcfg::Cpus_max];
+	#endif
+	static word_t _mask;  // bit per L4_ktrace_class_t
+
+	static inline void write(unsigned event, unsigned thrid, word_t arg0, word_t arg1)
+	{
+		#if Cfg_krn_ktrace
+		unsigned cpu = Smp::cpu();
+		Ring_t& r = _rings[cpu];
+		word_t wp = r.hdr.wp;
+		L4_ktrace_rec_t& rec = r.rec[wp & (Ring_recs - 1)];
+		rec.time   = Proc::cycles();
+		rec.thrid  = thrid;
+		rec.event  = event;
+		rec.cpu    = cpu;
+		rec.arg[0] = arg0;
+		rec.arg[1] = arg1;
+		__atomic_store_n(&r.hdr.wp, wp + 1, __ATOMIC_RELEASE);
+		#else
+		(void) event;
+		(void) thrid;
+		(void) arg0;
+		(void) arg1;
+		#endif
+	}
+
+public:
+
+	static inline void log(unsigned event, unsigned thrid, word_t arg0 = 0, word_t arg1 = 0)
+	{
+		if (Cfg_krn_ktrace  &&  (_mask & (1 << l4_ktrace_class(event))))
+			write(event, thrid, arg0, arg1);
+	}
+
+	static void init()
+	{
+		#if Cfg_krn_ktrace
+		for (unsigned i=0; i<Kcfg::Cpus_max; ++i)
+			_rings[i].hdr.size = Ring_recs;
+		#endif
+	}
+
+	static inline word_t mask()         { return _mask; }
+	static inline void   mask(word_t v) { _mask = v;    }
+
+	// memory of all rings to map to user
+	static inline addr_t area()    { return Cfg_krn_ktrace ? (addr_t)rings() : 0; }
+	static inline size_t area_sz() { return Cfg_krn_ktrace ? Kcfg::Cpus_max * sizeof(Ring_t) : 0; }
+
+	static inline void clear()
+	{
+		for (unsigned i=0; i<Kcfg::Cpus_max  &&  Cfg_krn_ktrace; ++i)
+			rings()[i].hdr.wp = 0;
+	}
+
+	// print last records of all CPUs
+	static void dump(Print_t dprint, unsigned last)
+	{
+		dprint("mask=0x%lx, ring records=%u.\n", (long)_mask, (unsigned)Ring_recs);
+		for (unsigned cpu=0; cpu<Kcfg::Cpus_max  &&  Cfg_krn_ktrace; ++cpu)
+		{
+			const Ring_t& r = rings()[cpu];
+			word_t wp = r.hdr.wp;
+			word_t n = min(min(wp, (word_t)Ring_recs), (word_t)last);
+			dprint("cpu %u:  written=%lu.\n", cpu, (long)wp);
+			dprint("%20s  %5s  %5s  %18s  %18s\n", "cycles", "thr", "event", "arg0", "arg1");
+			for (word_t i=wp-n; i!=wp; ++i)
+			{
+				const L4_ktrace_rec_t& rec = r.rec[i & (Ring_recs - 1)];
+				dprint("%20llu  %5u  0x%03x  0x%016llx  0x%016llx\n", (unsigned long long)rec.time,
+					rec.thrid, rec.event, (unsigned long long)rec.arg[0], (unsigned long long)rec.arg[1]);
+			}
+		}
+	}
+
+private:
+
+	static inline Ring_t* rings()
+	{
+		#if Cfg_krn_ktrace
+		return _rings;
+		#else
+		return 0;
+		#endif
+	}
+};
+
+#endif // KTRACE_H
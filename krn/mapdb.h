@@ -0,0 +1,344 @@
+//##################################################################################################
+//
+//  Mapdb - mapping database, derivation trees of user memory mappings.
+//
+//##################################################################################################
+
+#ifndef MAPDB_H
+#define MAPDB_H
+
+#include "task.h"
+#include "slab.h"
+#include "printk.h"
+#include "wlibc_assert.h"
+
+// Node describes fpage (or its part) mapped to task, children are mappings derived from it by
+// map items or pagefault replies. Mappings made by kernel (sigma0 memory, kip, utcb) have no
+// nodes, the first map from such memory creates root node (parent=0) for the source region.
+// Nodes are split if a part of them is revoked, moved or mapped from a part of parent.
+// Nodes of task don't overlap and are kept in treap ordered by va, lookups are O(log n).
+struct Map_node_t
+{
+	Task_t*     task;      // task that owns mapping
+	addr_t      va;        // start of mapping in task
+	size_t      sz;        //
+	addr_t      src_va;    // start of source region in parent's task
+	Map_node_t* parent;    // 0 for root node
+	Map_node_t* child;     // first derived mapping
+	Map_node_t* next;      // sibling list
+	Map_node_t* prev;      //
+	Map_node_t* tleft;     // treap of task's nodes
+	Map_node_t* tright;    //
+	unsigned    tprio;     // random treap priority
+
+	inline addr_t end() const { return va + sz; }
+};
+
+class Mapdb
+{
+	static Slab_t   _slab;
+	static uint32_t _seed;
+
+	static unsigned rand_prio()
+	{
+		_seed ^= _seed << 13;  // xorshift32
+		_seed ^= _seed >> 17;
+		_seed ^= _seed << 5;
+		return _seed;
+	}
+
+	// split tree to nodes with va < key (l) and the rest (r)
+	static void tsplit(Map_node_t* t, addr_t key, Map_node_t*& l, Map_node_t*& r)
+	{
+		if (!t)
+		{
+			l = r = 0;
+			return;
+		}
+		if (t->va < key)
+		{
+			tsplit(t->tright, key, t->tright, r);
+			l = t;
+		}
+		else
+		{
+			tsplit(t->tleft, key, l, t->tleft);
+			r = t;
+		}
+	}
+
+	// merge trees, all nodes of l are before nodes of r
+	static Map_node_t* tmerge(Map_node_t* l, Map_node_t* r)
+	{
+		if (!l  ||  !r)
+			return l ? l : r;
+		if (l->tprio > r->tprio)
+		{
+			l->tright = tmerge(l->tright, r);
+			return l;
+		}
+		r->tleft = tmerge(l, r->tleft);
+		return r;
+	}
+
+	// remove node from tree, return new root
+	static Map_node_t* terase(Map_node_t* t, Map_node_t* n)
+	{
+		wassert(t);
+		if (t == n)
+			return tmerge(n->tleft, n->tright);
+		if (n->va < t->va)
+			t->tleft = terase(t->tleft, n);
+		else
+			t->tright = terase(t->tright, n);
+		return t;
+	}
+
+	static void link_task(Map_node_t* n)
+	{
+		Map_node_t* l;
+		Map_node_t* r;
+		n->tleft  = 0;
+		n->tright = 0;
+		n->tprio  = rand_prio();
+		tsplit(n->task->map_nodes(), n->va, l, r);
+		n->task->map_nodes(tmerge(tmerge(l, n), r));
+	}
+
+	static void unlink_task(Map_node_t* n)
+	{
+		n->task->map_nodes(terase(n->task->map_nodes(), n));
+	}
+
+	static void link_child(Map_node_t* n)
+	{
+		n->prev = 0;
+		n->next = 0;
+		if (!n->parent)
+			return;
+		n->next = n->parent->child;
+		if (n->next)
+			n->next->prev = n;
+		n->parent->child = n;
+	}
+
+	static void unlink_child(Map_node_t* n)
+	{
+		if (!n->parent)
+			return;
+		if (n->prev)
+			n->prev->next = n->next;
+		else
+			n->parent->child = n->next;
+		if (n->next)
+			n->next->prev = n->prev;
+	}
+
+	static Map_node_t* create(Task_t* task, addr_t va, size_t sz, Map_node_t* parent, addr_t src_va)
+	{
+		Map_node_t* n = (Map_node_t*) _slab.alloc();
+		n->task   = task;
+		n->va     = va;
+		n->sz     = sz;
+		n->src_va = src_va;
+		n->parent = parent;
+		n->child  = 0;
+		link_child(n);
+		link_task(n);
+		return n;
+	}
+
+	static void destroy(Map_node_t* n)
+	{
+		wassert(!n->child);
+		unlink_child(n);
+		unlink_task(n);
+		_slab.free(n);
+	}
+
+	// node that contains va, else the nearest node after va, else 0
+	static Map_node_t* lookup(Task_t* task, addr_t va)
+	{
+		Map_node_t* res = 0;
+		Map_node_t* n = task->map_nodes();
+		while (n)
+		{
+			if (va < n->va)
+			{
+				res = n;
+				n = n->tleft;
+			}
+			else if (va < n->end())
+				return n;
+			else
+				n = n->tright;
+		}
+		return res;
+	}
+
+	// node that contains va
+	static Map_node_t* find(Task_t* task, addr_t va)
+	{
+		Map_node_t* n = lookup(task, va);
+		return n  &&  va >= n->va ? n : 0;
+	}
+
+	// start of the nearest node after va, or 'end' if no nodes in [va, end), va is not in any node
+	static addr_t next_node_va(Task_t* task, addr_t va, addr_t end)
+	{
+		Map_node_t* n = lookup(task, va);
+		wassert(!n  ||  n->va > va);
+		return n  &&  n->va < end ? n->va : end;
+	}
+
+	// split node at x, children crossing x are split too, return the right part
+	static Map_node_t* split(Map_node_t* n, addr_t x)
+	{
+		wassert(x > n->va  &&  x < n->end());
+
+		for (Map_node_t* c=n->child; c; c=c->next)
+			if (c->src_va < x  &&  x < c->src_va + c->sz)
+				split(c, c->va + (x - c->src_va));
+
+		Map_node_t* r = create(n->task, x, n->end() - x, n->parent, n->src_va + (x - n->va));
+		n->sz = x - n->va;
+
+		// move children derived from the right part
+		Map_node_t* c = n->child;
+		while (c)
+		{
+			Map_node_t* next = c->next;
+			if (c->src_va >= x)
+			{
+				unlink_child(c);
+				c->parent = r;
+				link_child(c);
+			}
+			c = next;
+		}
+		return r;
+	}
+
+	// cut region [va, va+sz) from node to separate node
+	static Map_node_t* carve(Map_node_t* n, addr_t va, size_t sz)
+	{
+		wassert(va >= n->va  &&  va + sz <= n->end());
+		if (va > n->va)
+			n = split(n, va);
+		if (va + sz < n->end())
+			split(n, va + sz);
+		return n;
+	}
+
+	// unmap node and all mappings derived from it
+	static void revoke(Map_node_t* n)
+	{
+		while (n->child)
+			revoke(n->child);
+		printk("Mapdb::%s:  task=%u, va=0x%lx, sz=0x%zx.\n", __func__, n->task->id(), n->va, n->sz);
+		n->task->unmap(n->va, n->sz);
+		destroy(n);
+	}
+
+	// revoke all task nodes crossing region
+	static void revoke(Task_t* task, addr_t va, size_t sz)
+	{
+		addr_t end = va + sz;
+		for (Map_node_t* n=lookup(task, va);  n  &&  n->va < end;  n=lookup(task, va))
+		{
+			addr_t lo = max(va, n->va);
+			addr_t hi = min(end, n->end());
+			revoke(carve(n, lo, hi - lo));
+			va = hi;  // tree may be changed by recursive revoke, continue after revoked part
+		}
+	}
+
+public:
+
+	// record map from src to dst, must be called before dst is mapped,
+	// old mappings in dst are revoked together with derived ones
+	static void map(Task_t* src, addr_t src_va, Task_t* dst, addr_t dst_va, size_t sz)
+	{
+		printk("Mapdb::%s:  %u:0x%lx -> %u:0x%lx, sz=0x%zx.\n", __func__,
+			src->id(), src_va, dst->id(), dst_va, sz);
+		if (src == dst)
+			return;  // no derivation inside task
+
+		// source region may consist of several nodes and regions without nodes
+		addr_t end = src_va + sz;
+		for (addr_t va=src_va; va<end; )
+		{
+			Map_node_t* parent = find(src, va);
+			addr_t piece_end = parent ? min(end, parent->end()) : next_node_va(src, va, end);
+			size_t piece_sz = piece_end - va;
+			addr_t piece_dst = dst_va + (va - src_va);
+
+			// the same mapping again (e.g. to upgrade access) keeps derived mappings
+			Map_node_t* old = find(dst, piece_dst);
+			if (!(parent  &&  old  &&  old->parent == parent  &&  old->src_va == va  &&
+			      old->va == piece_dst  &&  old->sz == piece_sz))
+			{
+				revoke(dst, piece_dst, piece_sz);
+				parent = find(src, va);  // revoke may destroy parent if src got it from dst
+				if (!parent)
+					parent = create(src, va, piece_sz, 0, va);  // root for kernel made mapping
+				piece_end = min(piece_end, parent->end());
+				create(dst, piece_dst, piece_end - va, parent, va);
+			}
+			va = piece_end;
+		}
+	}
+
+	// record grant from src to dst, must be called before dst is mapped and src is unmapped,
+	// granted nodes are moved to dst and keep their position in trees
+	static void grant(Task_t* src, addr_t src_va, Task_t* dst, addr_t dst_va, size_t sz)
+	{
+		printk("Mapdb::%s:  %u:0x%lx -> %u:0x%lx, sz=0x%zx.\n", __func__,
+			src->id(), src_va, dst->id(), dst_va, sz);
+		if (src == dst)
+			return;
+
+		revoke(dst, dst_va, sz);
+
+		addr_t end = src_va + sz;
+		for (addr_t va=src_va; va<end; )
+		{
+			Map_node_t* n = find(src, va);
+			if (!n)
+			{
+				va = next_node_va(src, va, end);  // kernel made mapping, nothing to move
+				continue;
+			}
+			n = carve(n, va, min(end, n->end()) - va);
+			addr_t new_va = dst_va + (n->va - src_va);
+
+			unlink_task(n);
+			for (Map_node_t* c=n->child; c; c=c->next)
+				c->src_va = new_va + (c->src_va - n->va);
+			n->task = dst;
+			n->va = new_va;
+			link_task(n);
+
+			va = src_va + (n->end() - dst_va);
+		}
+	}
+
+	// unmap region from task and revoke all mappings derived from it
+	static void unmap(Task_t* task, addr_t va, size_t sz)
+	{
+		revoke(task, va, sz);
+		task->unmap(va, sz);  // parts without nodes
+	}
+
+	// revoke all task mappings before task deletion
+	static void remove_task(Task_t* task)
+	{
+		while (task->map_nodes())
+			revoke(task->map_nodes());
+	}
+
+	static inline unsigned nodes() { return _slab.used();  }
+	static inline unsigned pages() { return _slab.pages(); }
+};
+
+#endif // MAPDB_H
@@ -8,6 +8,8 @@
 #define PAGE_TABLE_H
 
 #define USE_MMU_ASSERT
+#include "krn-config.h"
+#include "kconfig.h"
 #include "mmu.h"
 #include "printk.h"
 #include "sys_types.h"
@@ -83,8 +85,41 @@ private:
 		return true;
 	}
 
+	inline Child_ptable* child_table(word_t* cell)
+	{
+		paddr_t child_pa = mmu_get_dir_pa(Level, cell);
+		return (Child_ptable*) kmem_vaddr(child_pa, Child_ptable::Table_bytes);
+	}
+
+	// replace large page by child table with the same mapping to change part of it
+	Child_ptable* demote(addr_t va, word_t* cell)
+	{
+		addr_t base = round_down(va, Page_sz);
+		paddr_t pa = mmu_get_map_pa(Level, cell);
+		unsigned access = mmu_get_map_access(Level, cell);
+		unsigned cachable = mmu_get_map_cached(Level, cell);
+		Child_ptable* child = (Child_ptable*) create_table(Child_ptable::Table_bytes);
+		child->map(base, pa, Page_sz, access, cachable, false);
+		mmu_set_dir(Level, cell, kmem_paddr(child, Child_ptable::Table_bytes));
+		return child;
+	}
+
 public:
 
+	// free all child tables, used if large page replaces dir record
+	void destroy()
+	{
+		for (unsigned i=0; i<Table_sz; ++i)
+		{
+			if (mmu_is_dir(Level, table + i))
+			{
+				Child_ptable* child = child_table(table + i);
+				child->destroy();
+				kmem_free(child);
+			}
+		}
+	}
+
 	// print tables structure
 	static void print_structure()
 	{
@@ -180,7 +215,8 @@ public:
 		}
 	}
 
-	void map(addr_t vaddr, paddr_t paddr, size_t size, unsigned access, unsigned cachable, bool allow_over_map)
+	// returns true if valid mapping was replaced and TLB may keep it
+	bool map(addr_t vaddr, paddr_t paddr, size_t size, unsigned access, unsigned cachable, bool allow_over_map)
 	{
 		//force_printk_uart("Ptable::%s:  lev=%u:  va=%lx, pa=%llx, sz=0x%zx.\n", __func__,
 		//	Level, vaddr, (long long)paddr, size);
@@ -192,6 +228,7 @@ public:
 		wassert(access < 8);
 		wassert(cachable < 2);
 
+		bool over_mapped = false;
 		addr_t va = vaddr;
 		size_t rest = size;
 		while (rest)
@@ -200,18 +237,27 @@ public:
 			//printk("Ptable::%s:  lev=%u:  va=%lx, cell=%p/%lx, *cell=%lx.\n",
 			//	__func__, Level, va, cell, (va & Index_mask) >> Addr_index_low, *cell);
 
-			if (!(va & Offset_mask)  &&  rest >= Page_sz) // whole page
+			// whole page, use the largest one that va, pa and rest allow
+			if (!(va & Offset_mask)  &&  !((paddr + va - vaddr) & Offset_mask)  &&  rest >= Page_sz  &&
+			    mmu_has_map(Level))
 			{
 				//printk("Ptable::%s:  lev=%u:  va=%lx, pa=%llx, sz=0x%lx, cache=%u, acc=%u.\n",
 				//	__func__, Level, va, paddr + va - vaddr, Page_sz, cachable, access);
 
 				// L4:  Pages already mapped in the mappee’s address space that would conflict
 				//      with new mappings are implicitly unmapped before new pages are mapped.
-				if (!allow_over_map  &&  mmu_is_map(Level, cell))
+				if (!allow_over_map  &&  !mmu_is_inv(Level, cell))
 					panic("%s:  over mapping while allow_over_map=false:  lev=%u, va=%lx.", __func__, Level, va);
 				if (mmu_is_dir(Level, cell))
-					panic("IMPLME:  over mapping, need unmap old mapping:  lev=%u, va=%lx.", Level, va);
+				{
+					Child_ptable* child = child_table(cell);
+					child->destroy();
+					kmem_free(child);
+					mmu_set_inv(Level, cell);
+					over_mapped = true;
+				}
 
+				over_mapped |= mmu_is_map(Level, cell);
 				mmu_set_map(Level, cell, paddr + va - vaddr, access, cachable);
 				va += Page_sz;
 				rest -= Page_sz;
@@ -235,19 +281,23 @@ public:
 					child = (Child_ptable*) kmem_vaddr(child_pa, child_sz);
 				}
 				else if (mmu_is_map(Level, cell))
-					panic("Attempt to map, walk to next level ptable, but already mapped:  lev=%u, va=%lx.",
-						Level, va);
+				{
+					if (!allow_over_map)
+						panic("%s:  over mapping while allow_over_map=false:  lev=%u, va=%lx.", __func__, Level, va);
+					child = demote(va, cell);
+				}
 				else
 					panic("Unknown cell type:  lev=%u, cell=0x%lx.", Level, *cell);
 
 				// map in child page
 				size_t len = min(rest, Page_sz - (va & Offset_mask));
-				child->map(va, paddr + va - vaddr, len, access, cachable, allow_over_map);
+				over_mapped |= child->map(va, paddr + va - vaddr, len, access, cachable, allow_over_map);
 
 				va += len;
 				rest -= len;
 			}
 		}
+		return over_mapped;
 	}
 
 	// TODO:  do case than mapped L2 and unmaping l3 --> need:
@@ -282,14 +332,15 @@ public:
 			}
 			else if (mmu_is_map(Level, cell))
 			{
-				if (rest < Page_sz)
-					panic("Unmap high-level table but need low-level:  lev=%u, cell_val=0x08%lx.", Level, *cell);
-				len = Page_sz;
-				mmu_set_inv(Level, cell);
+				len = min(rest, Page_sz - (va & Offset_mask));
+				if (len < Page_sz)
+					demote(va, cell)->unmap(va, len);  // unmap part of large page
+				else
+					mmu_set_inv(Level, cell);
 			}
 			else if (mmu_is_inv(Level, cell))
 			{
-				len = min(rest, Page_sz);
+				len = min(rest, Page_sz - (va & Offset_mask));
 				//panic("Unmap but all or part of region is not mapped:  lev=%u, cell_val=0x08%lx.", Level, *cell);
 			}
 
@@ -364,7 +415,8 @@ public:
 	static void print_structure() { return; }
 	void dump(addr_t) { panic("dump"); }
 	void init() { panic("init"); }
-	void map(addr_t, paddr_t, size_t, unsigned, unsigned, bool) { panic("map"); }
+	void destroy() { panic("destroy"); }
+	bool map(addr_t, paddr_t, size_t, unsigned, unsigned, bool) { panic("map");  return false; }
 	void unmap(addr_t, size_t) { panic("unmap"); }
 	paddr_t walk(addr_t, size_t) { panic("walk");  return 0; }
 	void set_dir(addr_t, unsigned, void*) { panic("set_dir"); }
@@ -398,18 +450,26 @@ public:
 # error Unsupported arch
 #endif
 
+// TLB entries are tagged by context:  sparc - by ctx number, x86_64 - by PCID.
+// arm uses legacy (ARMv5) descriptors without nG bit, so all its entries are global for ASID.
+#if Cfg_krn_tlbtags  &&  (defined(Cfg_arch_sparc) || defined(Cfg_arch_x86_64))
+  #define USE_TLB_TAGS
+#endif
+
 //--------------------------------------------------------------------------------------------------
 class Pgtab
 {
 	enum
 	{
-		Kspace_sz = 16 * 0x100000,                                // use <= 16 MB for kspace
-		Ktbs      = Kspace_sz / Ktab_t::Aspace_sz,                // number of Ktab_t's  for kspace
 		Kern_va   = round_down(Cfg_krn_vaddr, Ktab_t::Aspace_sz), // start of kernel virt space
+		Kspace_min = Cfg_krn_vaddr - Kern_va + Kcfg::Kspace_sz,   // all kernel regions
+		Kspace_sz = round_up(Kspace_min > 0x1000000 ? Kspace_min : 0x1000000, Ktab_t::Aspace_sz), // >= 16 MB
+		Ktbs      = Kspace_sz / Ktab_t::Aspace_sz,                // number of Ktab_t's  for kspace
 	};
 
 	static_assert(is_aligned(Kspace_sz, Ktab_t::Aspace_sz));
 	static_assert(is_aligned(Kern_va, Ktab_t::Aspace_sz));
+	static_assert((addr_t)Kern_va + Kspace_sz - 1 > (addr_t)Kern_va, "kspace is too big, decrease usr_krn_thrbits");
 
 	// common for all contexts data
 	static Ktab_t* kerntb[Ktbs];      // l2 ptables for kernel space
@@ -418,9 +478,39 @@ class Pgtab
 	static word_t* ctxtb;             // context table
 	#endif
 
+	#if defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+	static bool tags_on;              // CPU supports PCID
+	static unsigned tag_next;         // next free PCID in current generation
+	static unsigned tag_gen_cur;      // current PCID generation, incremented at rollover
+	#endif
+
 	// individual context data
 	Ptable_l1* roottb;                // root page table
 	unsigned ctxid;                   // may be used as ctx num in ctxtb
+	bool tlb_dirty;                   // TLB may keep stale entries of this context
+
+	#if defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+	unsigned tag;                     // PCID, valid if tag_gen == tag_gen_cur
+	unsigned tag_gen;                 // PCID generation
+
+	// allocate PCID if context has no valid one, return true if PCID is new
+	bool tag_alloc()
+	{
+		if (tag_gen == tag_gen_cur)
+			return false;
+
+		if (tag_next == Mmu_pcid_max)
+		{
+			// rollover:  invalidate all PCIDs and start new generation
+			mmu_tlb_flush_all();
+			tag_gen_cur++;
+			tag_next = 1;  // PCID=0 is used by kernel before the first context switch
+		}
+		tag = tag_next++;
+		tag_gen = tag_gen_cur;
+		return true;
+	}
+	#endif
 
 public:
 
@@ -431,6 +521,10 @@ public:
 
 		wassert(!kerntb[0] && "Already inited.");
 
+		#ifdef Cfg_arch_x86_64
+		mmu_init();
+		#endif
+
 		#ifdef USE_CTXTB
 		// create context ptable (L0)
 		ctxtb = create_table(Ctx_bytes);
@@ -444,7 +538,7 @@ public:
 	}
 
 	// initialize individual context data
-	explicit Pgtab(unsigned ctx) : ctxid(ctx)
+	explicit Pgtab(unsigned ctx) : ctxid(ctx), tlb_dirty(false)
 	{
 		printk("Pgtab::%s:  hello, ctx=%u.\n", __func__, ctx);
 		wassert(ctx <= 0xff);
@@ -453,6 +547,11 @@ public:
 		// create root ptable
 		roottb = (Ptable_l1*) create_table(Ptable_l1::Table_bytes);
 
+		#if defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+		tag = 0;
+		tag_gen = 0;
+		#endif
+
 		#ifdef USE_CTXTB
 		// set roottb in ctxtb
 		mmu_set_dir(0, ctxtb + ctxid, kmem_paddr(roottb, Ptable_l1::Table_bytes));
@@ -491,7 +590,8 @@ public:
 	inline void map(addr_t va, paddr_t pa, size_t sz, unsigned access, unsigned cachable)
 	{
 		// TODO:  wassert(not-in-kerntb)
-		roottb->map(va, pa, sz, access, cachable, true);
+		if (roottb->map(va, pa, sz, access, cachable, true))
+			tlb_dirty = true;
 		Proc::dcache_flush(); // FIXME: use uncached memory for ptab or flush one some lines, not entire cache
 	}
 
@@ -500,9 +600,33 @@ public:
 	{
 		// TODO:  wassert(not-in-kerntb)
 		roottb->unmap(va, sz);
+		tlb_dirty = true;
 		Proc::dcache_flush(); // FIXME: use uncached memory for ptab or flush one some lines, not entire cache
 	}
 
+	// drop stale TLB entries after map/unmap, must be called for current context only
+	inline void tlb_sync()
+	{
+		if (tlb_dirty)
+		{
+			mmu_tlb_flush();
+			tlb_dirty = false;
+		}
+	}
+
+	// invalidate TLB entries of all contexts
+	static inline void tlb_flush_all()
+	{
+		#if defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+		if (tags_on)
+		{
+			mmu_tlb_flush_all();
+			return;
+		}
+		#endif
+		mmu_tlb_flush();
+	}
+
 	// walk in root ptable
 	inline paddr_t walk(addr_t va, size_t sz)
 	{
@@ -539,6 +663,26 @@ public:
 		unsigned index = (va - Kern_va) / Ktab_t::Aspace_sz;
 		kerntb[index]->unmap(va, sz);
 		Proc::dcache_flush(); // FIXME: use uncached memory for ptab or flush one some lines, not entire cache
+		#ifdef USE_TLB_TAGS
+		tlb_flush_all();  // kernel entries are not global and may be cached with any tag
+		#endif
+	}
+
+	// remap one page of kernel window (e.g. IPC copy window) without unmapping,
+	// the window must be accessed on this CPU after remapping only
+	static inline void kremap_page(addr_t va, paddr_t pa, unsigned access, unsigned cachable)
+	{
+		wassert(va >= Kern_va  &&  va < (Kern_va + Kspace_sz));
+		unsigned index = (va - Kern_va) / Ktab_t::Aspace_sz;
+		kerntb[index]->map(va, pa, Cfg_page_sz, access, cachable, true);
+		#if defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+		// non-global entry of window may stay cached with tag of other context and be used
+		// after switch to it, global one is dropped by invlpg for all PCIDs
+		if (tags_on)
+			mmu_set_global(Ktab_t::Level, kerntb[index]->get_cell(va));
+		#endif
+		Proc::dcache_flush(); // FIXME: use uncached memory for ptab or flush one some lines, not entire cache
+		mmu_tlb_flush_page(va);
 	}
 
 	// walk in kernel ptable
@@ -557,6 +701,17 @@ public:
 		mmu_reg_ctxtb(kmem_paddr(ctxtb, Ctx_bytes));
 		mmu_tlb_flush();
 		#endif
+
+		#if defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+		// PCIDE may be set only if cr3[11:0] == 0
+		tags_on = mmu_is_pcid_supported()  &&  !(Proc::cr3() & (Mmu_pcid_max - 1));
+		if (tags_on)
+		{
+			mmu_enable_pcid();
+			mmu_enable_pge();  // for copy windows, see kremap_page()
+		}
+		printk("Pgtab::%s:  PCID %s.\n", __func__, tags_on ? "on" : "off");
+		#endif
 	}
 
 	// set current MMU context number
@@ -565,13 +720,38 @@ public:
 		Proc::dcache_flush();  // writeback dcache to memory
 		Proc::dcache_inval();  // invalidate dcache
 		Proc::icache_inval();  // invalidate icache
+
+		#if defined(USE_TLB_TAGS)  &&  defined(USE_CTXTB)
+
+		// ctx numbers are not reused, keep TLB entries of other contexts
+		mmu_reg_ctx(ctxid);
+		tlb_sync();
+
+		#elif defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+
+		paddr_t pa = kmem_paddr(roottb, L1_sz * sizeof(word_t));
+		if (!tags_on)
+		{
+			mmu_root_table(pa);  // invalidate TLB
+			return;
+		}
+		// new PCID may keep entries of previous generation owner
+		bool need_flush = tag_alloc()  ||  tlb_dirty;
+		mmu_root_table(pa, tag, !need_flush);
+		tlb_dirty = false;
+
+		#else
+
 		mmu_tlb_flush();       // invalidate TLB
+		tlb_dirty = false;
 
 		#ifdef USE_CTXTB
 		mmu_reg_ctx(ctxid);
 		#else
 		mmu_root_table(kmem_paddr(roottb, L1_sz * sizeof(word_t)));
 		#endif
+
+		#endif
 	}
 };
 
@@ -8,8 +8,13 @@
 #define SCHED_T
 
 #include "thread.h"
+#include "ksmp.h"
 
 Thread_t* threads_get_highest_prio_ready_thread();
+unsigned  threads_highest_ready_prio();
+#if Cfg_krn_tickless
+void threads_tickless_update(Thread_t* thr);
+#endif
 
 //extern unsigned irq_entry_depth;
 
@@ -26,7 +31,10 @@ inline void _preemtion_point()
 
 class Sched_t
 {
-	static Thread_t* _current;
+	static Thread_t* _current[Kcfg::Cpus_max];  // running thread of every CPU
+	static uint64_t  _next_calls;   // statistic:  number of next() calls
+	static uint64_t  _next_cycles;  // statistic:  cycles spent inside next()
+	static bool      _next_stat;    // statistic is collected, off after boot, 'sched on' in kdb
 
 private:
 
@@ -34,32 +42,68 @@ private:
 	static Thread_t* next()
 	{
 		//_preemtion_point();
-		return threads_get_highest_prio_ready_thread();
+		if (!_next_stat)
+			return threads_get_highest_prio_ready_thread();
+		uint64_t start = Proc::cycles();
+		Thread_t* nxt = threads_get_highest_prio_ready_thread();
+		_next_cycles += Proc::cycles() - start;
+		_next_calls++;
+		return nxt;
 	}
 
 public:
 
+	static uint64_t next_calls()  { return _next_calls;  }
+	static uint64_t next_cycles() { return _next_cycles; }
+	static bool     next_stat()   { return _next_stat;   }
+	static void     next_stat(bool on) { _next_stat = on; }
+
+	static void next_stat_reset()
+	{
+		_next_calls = 0;
+		_next_cycles = 0;
+	}
+
 	static Thread_t* current()
 	{
-		return _current;
+		return _current[Smp::cpu()];
+	}
+
+	// running thread of other CPU
+	static Thread_t* current(unsigned cpu)
+	{
+		wassert(cpu < Kcfg::Cpus_max);
+		return _current[cpu];
 	}
 
 	// TODO:  private
 	static void current(Thread_t* thr)
 	{
-		_current = thr;
+		_current[Smp::cpu()] = thr;
 	}
 
 	static void switch_to(Thread_t* nxt)
 	{
 		Thread_t* cur = current();
+
+		#if Cfg_krn_smp
+		// thread of other CPU will be run by its CPU, it got ipi from add_ready()
+		if (nxt->cpu() != Smp::cpu())
+		{
+			if (cur->state() == Thread_t::Ready)
+				return;
+			nxt = next();
+		}
+		#endif
+
 		if (cur != nxt)
 		{
 			//printk("%s:  nxt=%s, ra=0x%x.\n", __func__, nxt->name(), ((word_t*)nxt->ksp())[0]);
-			cur->store_floats();
+			#if Cfg_krn_tickless
+			threads_tickless_update(nxt);
+			#endif
 			current(nxt);
 			cur->context_switch(nxt); // after that 'cur' is changed to 'nxt'
-			cur->restore_floats();
 		}
 	}
 
@@ -68,6 +112,44 @@ public:
 		Thread_t* nxt = Sched_t::next();
 		switch_to(nxt);
 	}
+
+	#if Cfg_krn_smp
+	// switch if current CPU has ready thread with higher prio, used by ipi
+	static void reschedule()
+	{
+		Thread_t* cur = current();
+		if (cur->state() != Thread_t::Ready  ||  threads_highest_ready_prio() > cur->prio_max())
+			switch_to_next();
+	}
+
+	// move thread to other CPU ready queues,
+	// running thread is moved by own CPU inside kernel to save its context before other CPU get it
+	static void migrate(Thread_t* thr, unsigned cpu)
+	{
+		if (thr->cpu() == cpu)
+			return;
+
+		if (thr == current())
+		{
+			thr->cpu_migrate(Thread_t::No_cpu);
+			thr->cpu(cpu);
+			switch_to_next();
+			return;
+		}
+
+		for (unsigned i=0; i<Kcfg::Cpus_max; ++i)
+		{
+			if (i != Smp::cpu()  &&  current(i) == thr)
+			{
+				thr->cpu_migrate(cpu);
+				Smp::send_ipi(i, Smp::Ipi_resched);
+				return;
+			}
+		}
+
+		thr->cpu(cpu);
+	}
+	#endif
 };
 
 #endif // SCHED_T
@@ -9,6 +9,9 @@
 addr_t   Timer::_addr = -1;
 unsigned Timer::_sysclock_hz = 0;
 unsigned Timer::_period_usec = 0;
+unsigned Timer::_cnt_hz = 0;
+uint64_t Timer::_cnt_last = 0;
+uint64_t Timer::_cnt_ticks = 0;
 
 #include "kintc.h"
 
@@ -21,19 +24,38 @@ addr_t Uart::_addr = -1;
 #include "sysclock.h"
 
 L4_clock_t SystemClock_t::_sys_clock  = 0;
+L4_clock_t SystemClock_t::_deadline   = 0;
 L4_kip_t*  SystemClock_t::_kip        = 0;
 int        SystemClock_t::_inside_kdb = 0;
 int        SystemClock_t::_not_check  = 0;
+L4_clock_t SystemClock_t::_calib_usec = 0;
+uint64_t   SystemClock_t::_calib_cycles = 0;
+uint64_t   SystemClock_t::_calib_mult = 0;
 
 #include "kmem.h"
 
 Aspace::aspace_t Aspace::_kspace;
 Aspace::ranges_t Aspace::_ranges;
 psize_t Aspace::_diff_kva_kpa = 0;
-unsigned Aspace::_cur_mmu_ctxid = 0;
-Kmem::memory_t Kmem::memory;
-uint8_t Kmem::premapped_mem [Pool_init_sz] __attribute__((aligned(Cfg_page_sz))); // premapped memory
+unsigned Aspace::_cur_mmu_ctxid[Kcfg::Cpus_max];
+addr_t Aspace::_copy_win[Kcfg::Cpus_max];
+uint8_t Kmem::premapped_mem [Pool_init_sz]; // premapped memory
+uint8_t Kmem::_pg_tag [Pool_pages];
+Slab_t* Kmem::_pg_slab [Pool_pages];
+Kmem::Block_t* Kmem::_blocks [Order_max + 1];
+unsigned Kmem::_nblocks [Order_max + 1];
 size_t Kmem::pool_sz = Pool_init_sz;
+size_t Kmem::pool_min = Pool_init_sz;
+Slab_t* Slab_t::_first = 0;
+Slab_t Kmem::_caches [Caches] =
+{
+	{ "kmem-64",     64 },
+	{ "kmem-128",   128 },
+	{ "kmem-256",   256 },
+	{ "kmem-512",   512 },
+	{ "kmem-1024", 1024 },
+	{ "kmem-2048", 2048 }
+};
 
 #include "ptable.h"
 
@@ -41,16 +63,59 @@ Ktab_t* Pgtab::kerntb[Ktbs];
 #ifdef USE_CTXTB
 word_t* Pgtab::ctxtb = 0;
 #endif
+#if defined(USE_TLB_TAGS)  &&  defined(Cfg_arch_x86_64)
+bool Pgtab::tags_on = false;
+unsigned Pgtab::tag_next = 1;
+unsigned Pgtab::tag_gen_cur = 1;
+#endif
 
 #include "task.h"
 
 unsigned Task_t::_counter = 0;
 Tasks_t::tasks_t Tasks_t::_tasks;
 
+#include "mapdb.h"
+
+Slab_t Mapdb::_slab("mapdb", sizeof(Map_node_t));
+uint32_t Mapdb::_seed = 2463534242u;
+
 #include "sched.h"
 
-Thread_t* Sched_t::_current = 0;
+Thread_t* Sched_t::_current[Kcfg::Cpus_max];
+uint64_t  Sched_t::_next_calls = 0;
+uint64_t  Sched_t::_next_cycles = 0;
+bool      Sched_t::_next_stat = false;
+
+#include "ksmp.h"
+
+volatile long     Smp::_bkl    = 0;
+volatile unsigned Smp::_online = 1;  // boot CPU
 
 #include "log.h"
 
 Log_buf_t Log::_cbuf;
+
+#include "ktrace.h"
+
+#if Cfg_krn_ktrace
+Ktrace::Ring_t Ktrace::_rings[Kcfg::Cpus_max];
+#endif
+word_t Ktrace::_mask = 0;
+
+#include "kprof.h"
+
+#if Cfg_krn_kprof
+L4_kprof_sample_t Kprof::_samples[Kprof::Samples_max];
+L4_kprof_sample_t Kprof::_sorted[Kprof::Samples_max];
+#endif
+unsigned Kprof::_cnt  = 0;
+unsigned Kprof::_lost = 0;
+bool     Kprof::_on   = false;
+
+#include "ipcstat.h"
+
+Ipcstat::Pair_t Ipcstat::_pairs[Ipcstat::Pairs_max];
+unsigned Ipcstat::_cnt   = 0;
+unsigned Ipcstat::_lost  = 0;
+unsigned Ipcstat::_epoch = 0;
+bool     Ipcstat::_on    = false;
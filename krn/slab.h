@@ -0,0 +1,107 @@
+//##################################################################################################
+//
+//  Slab - allocator of fixed size kernel objects.
+//
+//##################################################################################################
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "sys_types.h"
+#include "sys_utils.h"
+#include "wlibc_assert.h"
+
+class Slab_t;
+addr_t kmem_slab_page(Slab_t* slab);  // defined in kmem.h
+
+// Takes whole pages from Kmem on demand and cuts them into objects, free objects are kept in
+// a singly linked list. Pages are not returned to Kmem. All caches are linked to the list
+// to show statistics in kdb.
+class Slab_t
+{
+public:
+
+	typedef void (*Print_t)(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+private:
+
+	struct Free_t
+	{
+		Free_t* next;
+	};
+
+	const char* _name;
+	size_t   _obj_sz;
+	unsigned _pg_objs;   // objects per page
+	Free_t*  _free;      // list of free objects
+	unsigned _pages;     // pages taken from Kmem
+	unsigned _used;      // allocated objects
+	unsigned _hwm;       // high-water mark of allocated objects
+	Slab_t*  _next;      // list of all caches
+
+	static Slab_t* _first;
+
+	void grow()
+	{
+		addr_t pg = kmem_slab_page(this);
+		for (unsigned i=0; i<_pg_objs; ++i)
+		{
+			Free_t* obj = (Free_t*) (pg + (_pg_objs - 1 - i) * _obj_sz);  // lowest address first
+			obj->next = _free;
+			_free = obj;
+		}
+		_pages++;
+	}
+
+public:
+
+	Slab_t(const char* name, size_t obj_sz) :
+		_name(name),
+		_obj_sz(round_up(max(obj_sz, sizeof(Free_t)), sizeof(word_t))),
+		_pg_objs(Cfg_page_sz / _obj_sz),
+		_free(0),
+		_pages(0),
+		_used(0),
+		_hwm(0),
+		_next(_first)
+	{
+		wassert(_pg_objs);
+		_first = this;
+	}
+
+	void* alloc()
+	{
+		if (!_free)
+			grow();
+		Free_t* obj = _free;
+		_free = obj->next;
+		_used++;
+		if (_used > _hwm)
+			_hwm = _used;
+		return obj;
+	}
+
+	void free(void* p)
+	{
+		wassert(p  &&  _used);
+		Free_t* obj = (Free_t*) p;
+		obj->next = _free;
+		_free = obj;
+		_used--;
+	}
+
+	inline size_t   obj_sz() const { return _obj_sz;  }
+	inline unsigned used()   const { return _used;    }
+	inline unsigned pages()  const { return _pages;   }
+	inline unsigned hwm()    const { return _hwm;     }
+	inline unsigned avail()  const { return _pages * _pg_objs - _used; }
+
+	static void dump(Print_t dprint)
+	{
+		dprint("%-12s %6s %6s %6s %6s %6s\n", "cache", "objsz", "used", "free", "hwm", "pages");
+		for (const Slab_t* s=_first; s; s=s->_next)
+			dprint("%-12s %6zu %6u %6u %6u %6u\n", s->_name, s->_obj_sz, s->_used, s->avail(), s->_hwm, s->_pages);
+	}
+};
+
+#endif // SLAB_H
@@ -13,6 +13,11 @@ void arch_init()
 	// nothing for sparc
 }
 
+void arch_init_cpu()
+{
+	// nothing, SMP kernel is supported for arm only
+}
+
 void arch_set_timer_va(long va)
 {
 	extern unsigned timer_va;
@@ -192,6 +197,10 @@ void arch_switch_cpu(addr_t* cur_ksp, addr_t nxt_ksp, word_t nxt_utcb)
 
 void arch_store_floats(void* float_frame)
 {
+	// fpu may be disabled in kernel, enable it
+	word_t psr = Proc::psr();
+	Proc::psr(psr | (1<<12));  // psr.ef=1
+
 	asm volatile
 	(
 		"std %%f0,  [%[base] +   0]; "
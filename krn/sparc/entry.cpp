@@ -144,9 +144,8 @@ extern "C" void sparc_entry_bad_trap(unsigned ttype, unsigned psr, unsigned pc,
 		{
 			if (cur->flags() == 0x1)
 			{
-				// FPU is allowed for cur thread, enable it
-				cur->entry_frame()->enable_fpu();
-				cur->fpu_in_use(true);
+				// FPU is allowed for cur thread, switch FPU context to it
+				cur->fpu_acquire();
 				fixed = 1;
 			}
 		}
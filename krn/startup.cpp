@@ -9,6 +9,7 @@
 #include "kuart.h"
 #include "kdb.h"
 #include "log.h"
+#include "ktrace.h"
 #include "task.h"
 #include "libcio.h"
 #include "threads.h"
@@ -41,8 +42,23 @@ void dprint_intc(const char* fmt, ...)
 	va_end(args);
 }
 
+// SMP startup flags, values only increase
+enum
+{
+	Inter_cpu_start      = 1,  // init value     - not 0 to inter_cpu_flag be in .data, not .bss
+	Inter_cpu_io_ready   = 2,  // any CPU set    - slave CPUs may to use printf()
+	Inter_cpu_init_done  = 3,  // master CPU set - slave CPUs may to jump at kernel_entry_point
+	Inter_cpu_krn_ready  = 4   // master CPU set - kernel is ready, slave CPUs may run scheduler
+};
+
+static void set_inter_cpu_flag(long f);
+#if Cfg_krn_smp
+static Task_t* krn_task;  // kernel aspace for idle threads of slave CPUs
+#endif
+
 void kthread()
 {
+	Smp::lock();  // kernel thread works as kernel entry
 	printk("kthread:  hello.\n");
 
 	// setup timer
@@ -52,6 +68,11 @@ void kthread()
 		panic("Coud not set timer value:  clock=%u [hz], period=%u [usec].\n",
 			Cfg_sys_clock_hz, Cfg_krn_tick_usec);
 	Timer::start();
+	#if Cfg_krn_tickless
+	rc = Timer::counter_start();
+	if (rc)
+		panic("Coud not start timer counter:  clock=%u [hz].\n", Cfg_sys_clock_hz);
+	#endif
 	//Timer::dump(dprint_tmr);
 
 	SystemClock_t::init();
@@ -131,6 +152,10 @@ void kthread()
 	thr->start(kip->sigma0_ip, kip->sigma0_sp);
 	Sched_t::current()->name("idle"); // rename thread from 'krnl' to 'idle'
 	SystemClock_t::set_check(1);      // further kernel working time will be checked
+	#if Cfg_krn_smp
+	krn_task = Sched_t::current()->task();
+	set_inter_cpu_flag(Inter_cpu_krn_ready);  // slave CPUs may start own idle threads
+	#endif
 	Sched_t::switch_to(thr);          // go to sigma0
 
 	void idle_loop();
@@ -139,6 +164,7 @@ void kthread()
 
 void idle_loop()
 {
+	Smp::unlock();  // idle thread doesn't leave kernel
 	Proc::enable_irq();
 	while (1) // idle operation, TODO:  use arch "asr19" for sparc, "hlt" for x86, ...
 	{
@@ -197,13 +223,6 @@ bool b1 = check();
 
 // SMP
 
-enum
-{
-	Inter_cpu_start      = 1,  // init value     - not 0 to inter_cpu_flag be in .data, not .bss
-	Inter_cpu_io_ready   = 2,  // any CPU set    - slave CPUs may to use printf()
-	Inter_cpu_init_done  = 3   // master CPU set - slave CPUs may to jump at kernel_entry_point
-};
-
 volatile long cpu_ready [Cfg_max_cpus];
 volatile long inter_cpu_flag = Inter_cpu_start;  // not 0 to be in .data, not .bss
 
@@ -216,13 +235,21 @@ static void set_inter_cpu_flag(long f)
 
 static void wait_inter_cpu_flag(long f)
 {
-	while (inter_cpu_flag != f)
+	while (inter_cpu_flag < f)
 	{
 		Proc::wait_event();
 		Proc::rmb();
 	}
 }
 
+#if Cfg_krn_smp
+static void slave_idle()
+{
+	arch_set_ksp(Sched_t::current()->kentry_sp());
+	idle_loop();
+}
+#endif
+
 static void slave_cpu()
 {
 	wait_inter_cpu_flag(Inter_cpu_io_ready);
@@ -230,10 +257,21 @@ static void slave_cpu()
 	cpu_ready[Proc::cpuid()] = 1;
 	Proc::wmb();
 	wait_inter_cpu_flag(Inter_cpu_init_done);
+
+	#if Cfg_krn_smp
+	wait_inter_cpu_flag(Inter_cpu_krn_ready);
+	Smp::lock();
+	arch_init_cpu();
+	krn_task->set_current(true);  // fine tuned kernel mapping
+	Intc::init_cpu();
+	Smp::online(Proc::cpuid());
+	Threads_t::create_kthread_and_go((void*)slave_idle, krn_task, "idle", Proc::cpuid());
+	#else
 	while (1)
 	{
-		Proc::wait_event();  // TODO:  support SMP
+		Proc::wait_event();  // UP kernel, slave CPUs sleep
 	}
+	#endif
 }
 
 static void wait_slave_cpus(unsigned ncpu)
@@ -302,6 +340,7 @@ void startup()
 	Log::init((char*)log_buf, log_sz);
 	libcio_set_log();                    // next printk() will write to Log
 
+	Ktrace::init();
 	Kdb::init();
 
 	Task_t& tsk = Tasks_t::create();     // initial aspace
@@ -316,8 +355,8 @@ void startup()
 	// initialize KIP data
 	init_kip();
 
-	// alloc thread kernel stacks
-	Threads_t::alloc_kstack();
+	// threads and their kernel stacks are allocated on creation
+	Threads_t::init();
 
 	// run kernel thread
 	Threads_t::create_kthread_and_go((void*)kthread, &tsk, "krnl");
@@ -8,6 +8,10 @@
 #include "threads.h"
 #include "kuart.h"
 #include "l4_syscalls.h"
+#include "mapdb.h"
+#include "ktrace.h"
+#include "kprof.h"
+#include "ipcstat.h"
 #include <assert.h>
 
 void kdb_console_entry_wrapper(bool krn_mode, bool error_entry, const char* prompt);
@@ -50,6 +54,14 @@ void syscall_exchange_registers(Thread_t& cur, Entry_frame_t& eframe)
 		return;
 	}
 
+	// inactive thread has no kstack and entry frame
+	if (!dst_thr->is_active())
+	{
+		printk("exreg:  ERROR:  inactive thread:  dst=%u.\n", dst.number());
+		cur.uutcb()->error(2);         // UnavailableThread
+		return;
+	}
+
 	int etype = dst_thr->entry_type();
 
 	if (control & L4_exreg_ctl_d)
@@ -325,6 +337,7 @@ void syscall_thread_control(Thread_t& cur, Entry_frame_t& eframe)
 		if (tsk->is_empty())
 		{
 			printk("tctl:  delete task=%u.\n", tsk->id());
+			Mapdb::remove_task(tsk);
 			Tasks_t::remove(tsk);
 		}
 	}
@@ -404,7 +417,7 @@ void syscall_schedule(Thread_t& cur, Entry_frame_t& eframe)
 
 	// check incoming params
 	if (//TODO:  check time_ctl     ||
-	    //TODO:  check proc_ctl     ||
+	    (proc_ctl != (word_t)-1  &&  !Smp::is_online(proc_ctl))  ||
 	    prio > cur.prio()  // ||
 	    //TODO:  check preempt_ctl
 	    )
@@ -423,7 +436,10 @@ void syscall_schedule(Thread_t& cur, Entry_frame_t& eframe)
 	// set processor control if need
 	if (proc_ctl != -1)
 	{
-		panic("IMPLEMENT ME:  set processor_control.\n");
+		#if Cfg_krn_smp
+		Sched_t::migrate(dst_thr, proc_ctl);
+		#endif
+		// UP kernel:  the only online CPU is 0, nothing to do
 	}
 
 	// set priority if need
@@ -486,13 +502,13 @@ void syscall_unmap(Thread_t& cur, Entry_frame_t& eframe)
 		{
 			// wrm extention
 			printk("unmap:  complete aspace.\n");
-			cur.task()->unmap(0x0, 0xf0000000);
+			Mapdb::unmap(cur.task(), 0x0, 0xf0000000);
 			Threads_t::remap_user_utcb(cur.task());
 		}
 		else if (!fpage.is_nil())
 		{
 			printk("unmap:  va=0x%lx, sz=0x%lx.\n", fpage.addr(), fpage.size());
-			cur.task()->unmap(fpage.addr(), fpage.size());
+			Mapdb::unmap(cur.task(), fpage.addr(), fpage.size());
 		}
 	}
 }
@@ -667,6 +683,77 @@ void syscall_kdb(Thread_t& cur, Entry_frame_t& eframe)
 			Threads_t::kdb_threads_entry((L4_kdb_thread_info_t*)data, size/sizeof(L4_kdb_thread_info_t));
 			break;
 		}
+		case L4_kdb_ktrace:
+		{
+			// param - class mask, data/size - user area for read-only rings of all CPUs
+			L4_thrid_t cur_id = cur.globid();
+			if (cur_id != thrid_sigma0()  &&  cur_id != thrid_roottask())
+			{
+				printk("kdb:  ktrace:  ERROR:  no privilege.\n");
+				eframe.scall_kdb_result(-1);
+				break;
+			}
+			if (data)
+			{
+				addr_t va = (addr_t)data;
+				if (!Ktrace::area_sz()  ||  !is_aligned(va, Cfg_page_sz)  ||  size < Ktrace::area_sz()  ||
+					!Aspace::is_user_range(va, Ktrace::area_sz()))
+				{
+					printk("kdb:  ktrace:  ERROR:  wrong area:  addr=0x%lx, sz=0x%zx.\n", va, size);
+					eframe.scall_kdb_result(-1);
+					break;
+				}
+				cur.task()->map(va, kmem_paddr(Ktrace::area(), Ktrace::area_sz()), Ktrace::area_sz(),
+					Acc_ukip, Cachable);
+			}
+			Ktrace::mask(param);
+			break;
+		}
+		case L4_kdb_kprof:
+		{
+			L4_thrid_t cur_id = cur.globid();
+			if (cur_id != thrid_sigma0()  &&  cur_id != thrid_roottask())
+			{
+				printk("kdb:  kprof:  ERROR:  no privilege.\n");
+				eframe.scall_kdb_result(-1);
+				break;
+			}
+			if (param == L4_kprof_start)
+				Kprof::start();
+			else if (param == L4_kprof_stop)
+				Kprof::stop();
+			else if (param == L4_kprof_read)
+				eframe.scall_kdb_result(Kprof::read(cur.task(), (addr_t)data, size/sizeof(L4_kprof_sample_t)));
+			else
+				eframe.scall_kdb_result(-1);
+			break;
+		}
+		case L4_kdb_ipcstat:
+		{
+			if (!Cfg_krn_ipcstat)
+				eframe.scall_kdb_result(-1);
+			else if (param == L4_ipcstat_start)
+				Ipcstat::start();
+			else if (param == L4_ipcstat_stop)
+				Ipcstat::stop();
+			else if (param == L4_ipcstat_info  &&  size >= sizeof(L4_ipcstat_info_t))
+				Ipcstat::info((L4_ipcstat_info_t*)data);
+			else if (param == L4_ipcstat_pairs)
+				eframe.scall_kdb_result(Ipcstat::read((L4_ipcstat_pair_t*)data, size/sizeof(L4_ipcstat_pair_t)));
+			else if (param == L4_ipcstat_thread  &&  size >= sizeof(L4_ipcstat_thread_t))
+			{
+				L4_ipcstat_thread_t* info = (L4_ipcstat_thread_t*)data;
+				Thread_t* thr = Threads_t::find(info->thrid);
+				#if Cfg_krn_ipcstat
+				if (thr)
+					Ipcstat::read(thr->ipcstat(), &info->blocked);
+				#endif
+				eframe.scall_kdb_result(thr ? 0 : -1);
+			}
+			else
+				eframe.scall_kdb_result(-1);
+			break;
+		}
 		default:
 			printk("kdb:  ERROR:  unknown opcode=%ld.\n", opcode);
 			eframe.scall_kdb_result(-1);
@@ -674,9 +761,27 @@ void syscall_kdb(Thread_t& cur, Entry_frame_t& eframe)
 }
 
 void do_ipc(Thread_t& cur, Entry_frame_t& eframe);
+void do_lipc(Thread_t& cur, Entry_frame_t& eframe);
 
 void syscall_ipc(Thread_t& cur, Entry_frame_t& eframe)
 {
+	L4_thrid_t to        = eframe.scall_ipc_to();
+	L4_thrid_t from_spec = eframe.scall_ipc_from_spec();
+	Ktrace::log(L4_ktrace_ipc_send, cur.globid().number(), to.raw(), cur.uutcb()->mr[0]);
+	cur.ipcstat_entry(!to.is_nil());
 	do_ipc(cur, eframe);
+	cur.ipcstat_exit(!to.is_nil()  &&  to == from_spec);
+	Ktrace::log(L4_ktrace_ipc_recv, cur.globid().number(), eframe.scall_ipc_from(), cur.uutcb()->mr[0]);
+}
+
+void syscall_lipc(Thread_t& cur, Entry_frame_t& eframe)
+{
+	L4_thrid_t to        = eframe.scall_ipc_to();
+	L4_thrid_t from_spec = eframe.scall_ipc_from_spec();
+	Ktrace::log(L4_ktrace_ipc_send, cur.globid().number(), to.raw(), cur.uutcb()->mr[0]);
+	cur.ipcstat_entry(!to.is_nil());
+	do_lipc(cur, eframe);
+	cur.ipcstat_exit(!to.is_nil()  &&  to == from_spec);
+	Ktrace::log(L4_ktrace_ipc_recv, cur.globid().number(), eframe.scall_ipc_from(), cur.uutcb()->mr[0]);
 }
 
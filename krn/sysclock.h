@@ -13,6 +13,7 @@
 #include "kintc.h"
 #include "kkip.h"
 #include "wlibc_panic.h"
+#include "sys_proc.h"
 #include <stdio.h>
 
 #ifdef DEBUG
@@ -22,12 +23,78 @@
 class SystemClock_t
 {
 	static L4_clock_t _sys_clock;   // value is updated every system's timer tick
+	static L4_clock_t _deadline;    // time of next timer irq
 	static L4_kip_t*  _kip;         // kip pointer
 	static int        _inside_kdb;  // inside kdb flag, don't read timer value if 1, use prev value
 	static int        _not_check;   // don't check how long CPU in krn mode, it is used while system startup
+	static L4_clock_t _calib_usec;  // start of cycle counter calibration period
+	static uint64_t   _calib_cycles;//
+	static uint64_t   _calib_mult;  // calibrated usec per cycle, 32.32
 
 public:
 
+	enum
+	{
+		Calib_period_usec = 1000*1000,
+		Slew_usec         = 100*1000    // user clock error is corrected during this time
+	};
+
+	// Update clock data of kip, it allows user to get clock without syscall. Cycle counter
+	// is calibrated by timer every period, till the first period user does syscall.
+	// User clock is never stepped back:  new base is the value user computes by old data,
+	// and error against kernel clock is slewed out by changing user clock rate. User clock
+	// that is late more than Slew_usec/2 is stepped forward.
+	static void publish(L4_clock_t now)
+	{
+		#if defined (Cfg_arch_x86) or defined (Cfg_arch_x86_64)  // cycle counter is readable by user
+		if (!_kip)
+			return;
+		uint64_t cycles = Proc::cycles();
+		L4_kip_clock_t* clk = &_kip->clock;
+
+		if (!_calib_usec)
+		{
+			_calib_usec = now;
+			_calib_cycles = cycles;
+			return;
+		}
+
+		if (now - _calib_usec >= Calib_period_usec  &&  cycles > _calib_cycles)
+		{
+			_calib_mult = ((now - _calib_usec) << 32) / (cycles - _calib_cycles);
+			_calib_usec = now;
+			_calib_cycles = cycles;
+		}
+		if (!_calib_mult)
+			return;
+
+		L4_clock_t base = now;
+		int64_t err = 0;  // kernel clock - user clock
+		if (clk->usec_mult)
+		{
+			L4_clock_t user_now = clk->base_usec + (((cycles - clk->base_cycles) * clk->usec_mult) >> 32);
+			err = (int64_t)(now - user_now);
+			if (err < Slew_usec / 2)
+				base = user_now;
+			else
+				err = 0;  // too late, step forward
+			if (err < -Slew_usec / 2)
+				err = -Slew_usec / 2;
+		}
+		uint64_t mult = _calib_mult + (int64_t)_calib_mult * err / Slew_usec;
+
+		clk->seq++;  // odd - user retries reading
+		Proc::wmb();
+		clk->base_usec = base;
+		clk->base_cycles = cycles;
+		clk->usec_mult = mult;
+		Proc::wmb();
+		clk->seq++;
+		#else
+		(void) now;
+		#endif
+	}
+
 	static void init()
 	{
 		_kip = get_kip();
@@ -36,10 +103,50 @@ public:
 
 	static inline void tick()
 	{
+		#if Cfg_krn_tickless
+		_sys_clock = Timer::counter_usec();
+		#else
 		_sys_clock += Cfg_krn_tick_usec;
+		#endif
+		_deadline = _sys_clock + Timer::period_usec();
 		//printf("new tick=%llu.\n", _sys_clock);
 	}
 
+	static inline L4_clock_t deadline()
+	{
+		return _deadline;
+	}
+
+	#if Cfg_krn_tickless
+	// Restart timer to get irq at 'deadline'. Time is counted by free-running counter of
+	// timer, it isn't restarted, so reprogramming doesn't lose time.
+	static void reprogram(L4_clock_t deadline)
+	{
+		const unsigned Period_min_usec = 100;  // don't make irq storm
+
+		if (Intc::is_pending(Cfg_krn_timer_irq))
+			return;  // tick() will come soon, timer will be reprogrammed there
+
+		L4_clock_t now = Timer::counter_usec();
+		unsigned period = Timer::counter_max_period_usec();
+		if (deadline < now + period)
+			period = deadline > now + Period_min_usec  ?  deadline - now  :  Period_min_usec;
+
+		Timer::set(period);
+		Timer::start();
+
+		// previous period is expired while reprogramming, its irq isn't needed anymore
+		if (Intc::is_pending(Cfg_krn_timer_irq))
+		{
+			Timer::irq_ack();
+			Intc::clear(Cfg_krn_timer_irq);
+		}
+
+		_sys_clock = now;
+		_deadline = now + period;
+	}
+	#endif
+
 	static void inside_kdb(int v)
 	{
 		_inside_kdb = v;
@@ -69,10 +176,15 @@ public:
 		uint64_t res = 0;
 		if (Timer::inited() && Intc::inited())
 		{
+			#if Cfg_krn_tickless
+			// free-running counter doesn't depend on timer irq
+			(void) is_tick_irq_pending;
+			res = Timer::counter_usec();
+			#else
 			if (is_tick_irq_pending)
 			{
 				// timer irq is processing but tick() is not called yet
-				res = _sys_clock + Cfg_krn_tick_usec + Timer::value_usec();
+				res = _sys_clock + Timer::period_usec() + Timer::value_usec();
 			}
 			else
 			{
@@ -83,7 +195,7 @@ public:
 				uint64_t tmrval = 0;
 				if (Intc::is_pending(Cfg_krn_timer_irq))
 				{
-					tmrval = Cfg_krn_tick_usec + Timer::value_usec();
+					tmrval = Timer::period_usec() + Timer::value_usec();
 				}
 				else
 				{
@@ -93,10 +205,11 @@ public:
 					val[1] = Timer::value_usec();
 					#endif
 					if (Intc::is_pending(Cfg_krn_timer_irq))
-						tmrval = Cfg_krn_tick_usec + Timer::value_usec();
+						tmrval = Timer::period_usec() + Timer::value_usec();
 				}
 				res = _sys_clock + tmrval;
 			}
+			#endif
 
 			(void) place;
 
@@ -109,9 +222,9 @@ public:
 				// to take this feature into account there is parameter
 				// Cfg_krn_timer_lag_usec:  if timer value < Lag --> add tick,
 				// tick-irq will process a little late
-				#if (Cfg_krn_timer_lag_usec > 0)
+				#if (Cfg_krn_timer_lag_usec > 0)  &&  !Cfg_krn_tickless
 				if (res < prev  &&  Timer::value_usec() < Cfg_krn_timer_lag_usec)
-					res = _sys_clock + Cfg_krn_tick_usec + Timer::value_usec();
+					res = _sys_clock + Timer::period_usec() + Timer::value_usec();
 				#endif
     
 				if (res < prev)
@@ -13,9 +13,21 @@
 #include "arch_data.h"
 #include "bitmap.h"
 
+class Thread_t;
+struct Map_node_t;
+
 //--------------------------------------------------------------------------------------------------
 class Task_t
 {
+	enum { Utcbs_max = 64 };
+
+	// recent page translations, entry is free if va == -1
+	struct Walk_entry_t
+	{
+		addr_t  va;
+		paddr_t pa;
+	};
+
 	static unsigned _counter;         // for set id
 
 	unsigned     _id;                  //
@@ -23,10 +35,22 @@ class Task_t
 	Aspace       _aspace;              // virtual address space
 	L4_fpage_t   _kip_area;            // KIP area for user address space
 	L4_fpage_t   _utcb_area;           // UTCBs area for user address space
-	bitmap_t<64> _utcbs_bitmap;        // bitmap with busy utcb
+	bitmap_t<Utcbs_max> _utcbs_bitmap; // bitmap with busy utcb
+	Thread_t*    _utcb_threads[Utcbs_max]; // thread per utcb slot, to resolve local id
 	L4_thrid_t   _redirector;          //
+	Map_node_t*  _map_nodes;           // mapping db nodes of task
+	Walk_entry_t _walk_cache[Kcfg::Walk_cache_sz]; // VA->PA of recently walked pages
+	unsigned     _walk_next;           // next entry to replace
 	Arch_task_t  _arch;                //
 
+	// drop cached translations of region, called on any change of mappings
+	inline void walk_cache_inval(addr_t va, size_t sz)
+	{
+		for (unsigned i=0; i<Kcfg::Walk_cache_sz; ++i)
+			if (_walk_cache[i].va - va < sz)
+				_walk_cache[i].va = -1;
+	}
+
 public:
 
 	// for replacement new in list_t
@@ -41,6 +65,12 @@ public:
 		_kip_area = L4_fpage_t::create_nil();
 		_utcb_area = L4_fpage_t::create_nil();
 		_name[0] = 0;
+		_map_nodes = 0;
+		for (unsigned i=0; i<Utcbs_max; ++i)
+			_utcb_threads[i] = 0;
+		for (unsigned i=0; i<Kcfg::Walk_cache_sz; ++i)
+			_walk_cache[i].va = -1;
+		_walk_next = 0;
 
 		#if defined (Cfg_arch_arm) or defined (Cfg_arch_x86) or defined (Cfg_arch_x86_64)  or defined (Cfg_arch_sparc)
 		// for arm utcb address locates at 0xff000000
@@ -73,23 +103,43 @@ public:
 	inline L4_thrid_t redirector()   const { return _redirector;  }
 	inline void redirector(L4_thrid_t r) { _redirector = r; }
 
+	inline Map_node_t* map_nodes() const { return _map_nodes; }
+	inline void map_nodes(Map_node_t* n) { _map_nodes = n;    }
+
 	void map(addr_t va, paddr_t pa, size_t sz, kacc_t acc, unsigned cachable)
 	{
 		printk("Task::map:  id=%d, va=0x%08lx, pa=0x%llx, sz=0x%08zx, acc=%s.\n",
 			_id, va, (long long)pa, sz, Aspace::Type(acc, cachable).str());
+		walk_cache_inval(va, sz);
 		_aspace.map(va, pa, sz, acc, cachable);
 	}
 
 	void unmap(addr_t va, size_t sz)
 	{
 		printk("Task::unmap:  id=%d, va=0x%08lx, sz=0x%zx.\n", _id, va, sz);
+		walk_cache_inval(va, sz);
 		_aspace.unmap(va, sz);
 	}
 
+	// single pages are looked up in walk cache first, IPC copy path walks the same
+	// receive buffers again and again
 	paddr_t walk(addr_t va, size_t sz)
 	{
-		printk("Task::walk:  id=%d, va=0x%08lx, sz=0x%zx.\n", _id, va, sz);
-		return _aspace.walk(va, sz);
+		if (sz != Cfg_page_sz)
+			return _aspace.walk(va, sz);
+
+		for (unsigned i=0; i<Kcfg::Walk_cache_sz; ++i)
+			if (_walk_cache[i].va == va)
+				return _walk_cache[i].pa;
+
+		paddr_t pa = _aspace.walk(va, sz);
+		if (pa)
+		{
+			_walk_cache[_walk_next].va = va;
+			_walk_cache[_walk_next].pa = pa;
+			_walk_next = (_walk_next + 1) % Kcfg::Walk_cache_sz;
+		}
+		return pa;
 	}
 
 	inline paddr_t walk(void* p, size_t sz)  {  return walk((addr_t)p, sz);  }
@@ -105,6 +155,7 @@ private:
 	void map_kip()
 	{
 		paddr_t pa = kmem_paddr(get_kip(), Cfg_page_sz);
+		walk_cache_inval(_kip_area.addr(), Cfg_page_sz);
 		_aspace.map(_kip_area.addr(), pa, Cfg_page_sz, Acc_ukip, Cachable);
 	}
 
@@ -128,11 +179,14 @@ public:
 	inline L4_fpage_t kip_area()  { return _kip_area; }
 
 	// call then thread activated
-	inline addr_t alloc_utcb_uspace()
+	inline addr_t alloc_utcb_uspace(Thread_t* thr)
 	{
 		wassert(_utcb_area.addr() && _utcb_area.size());
 		int rc = _utcbs_bitmap.getfree();
-		return rc < 0  ?  0 : _utcb_area.addr() + rc * Cfg_page_sz;
+		if (rc < 0)
+			return 0;
+		_utcb_threads[rc] = thr;
+		return _utcb_area.addr() + rc * Cfg_page_sz;
 	}
 
 	inline void free_utcb_uspace(addr_t utcb)
@@ -144,6 +198,18 @@ public:
 		wassert(!rc);
 		if (rc)
 			force_printk("ERROR:  _utcbs_bitmap.getfree(%u) - rc=%d.\n", pos, rc);
+		else
+			_utcb_threads[pos] = 0;
+	}
+
+	// thread by user utcb address (local id), utcb slot is calculated from address
+	inline Thread_t* utcb_thread(addr_t utcb) const
+	{
+		addr_t base = _utcb_area.addr();
+		if (utcb < base  ||  (utcb - base) % Cfg_page_sz)
+			return 0;
+		unsigned pos = (utcb - base) / Cfg_page_sz;
+		return pos < _utcbs_bitmap.capacity()  ?  _utcb_threads[pos]  :  0;
 	}
 
 	inline bool is_empty() const
@@ -187,6 +253,28 @@ public:
 		return _aspace.is_inside_acc(fp);
 	}
 
+	// copy kernel data to user memory of this task, it must be current aspace;
+	// every page of 'dst' must be mapped to user with write access
+	bool copy_to_user(addr_t dst, const void* src, size_t len)
+	{
+		wassert(is_cur_aspace());
+		if (!len)
+			return true;
+		if (dst + len < dst)
+			return false;
+		for (addr_t pg=round_pg_down(dst); pg<dst+len; pg+=Cfg_page_sz)
+		{
+			if (!is_inside_acc(L4_fpage_t::create(pg, Cfg_page_sz, L4_fpage_t::Acc_w))  ||
+			    !walk(pg, Cfg_page_sz))
+			{
+				printk("Task::%s:  ERR:  no user write access:  va=0x%lx.\n", __func__, pg);
+				return false;
+			}
+		}
+		memcpy((void*)dst, src, len);
+		return true;
+	}
+
 	// return 'cached' attribute if OK or negative value if 'is_inside_acc' failed
 	inline int cached(L4_fpage_t fp)
 	{
@@ -6,10 +6,13 @@
 
 #include "thread.h"
 #include "arch.h"
+#include "ktrace.h"
 
 // static data
 unsigned Thread_t::_counter = 0;
+Thread_t* Thread_t::_fpu_owner[Kcfg::Cpus_max];
 unsigned Int_thread_t::_counter = 0;
+unsigned Int_thread_t::_held = 0;
 
 
 void Thread_t::context_switch(Thread_t* next)
@@ -19,6 +22,10 @@ void Thread_t::context_switch(Thread_t* next)
 	//	cnt++, name(), state_str(), _ksp, unused_kstack_sz(),
 	//	next->name(), next->state_str(), next->_ksp, next->unused_kstack_sz());
 
+	Ktrace::log(L4_ktrace_switch, globid().number(), next->globid().number(), next->prio_max());
+
+	fpu_save();
+
 	// set kernel entry stack pointer
 	arch_set_ksp(next->kentry_sp());
 
@@ -12,15 +12,19 @@
 #include "sys_stack.h"
 #include "l4_types.h"
 #include "l4_syscalls.h"
+#include "l4_ipcerr.h"
 #include "task.h"
 #include "sysclock.h"
 #include "thrid.h"
 #include "tmaccount.h"
+#include "ipcstat.h"
 #include "arch.h"
+#include "ksmp.h"
+#include "slab.h"
 #include "wlibc_assert.h"
 
 class Thread_t;
-typedef list_t <Thread_t*, Kcfg::Threads_max> threads_t;
+typedef list_t <Thread_t*> threads_t;  // items are allocated on demand, see Threads_t::init()
 
 // helper for threads_t
 static inline bool is_exist(threads_t* list, Thread_t* thr)
@@ -53,12 +57,11 @@ static void dump(threads_t* list)
 // helpers to call Threads_t members
 threads_t::iter_t threads_add_ready(Thread_t* thr);
 threads_t::iter_t threads_del_ready(threads_t::iter_t it);
-threads_t::iter_t threads_add_send(Thread_t* thr);
-threads_t::iter_t threads_del_send(threads_t::iter_t it);
-threads_t::iter_t threads_add_rcv_timeout_waiting(Thread_t* thr);
-threads_t::iter_t threads_del_rcv_timeout_waiting(threads_t::iter_t it);
-threads_t::iter_t threads_add_snd_timeout_waiting(Thread_t* thr);
-threads_t::iter_t threads_del_snd_timeout_waiting(threads_t::iter_t it);
+threads_t::iter_t threads_replace_ready(threads_t::iter_t it, Thread_t* thr);
+void              threads_add_rcv_timeout_waiting(Thread_t* thr);
+void              threads_del_rcv_timeout_waiting(Thread_t* thr);
+void              threads_add_snd_timeout_waiting(Thread_t* thr);
+void              threads_del_snd_timeout_waiting(Thread_t* thr);
 threads_t::iter_t threads_timeslice_expired();
 Thread_t*         threads_find(L4_thrid_t id);
 
@@ -72,7 +75,7 @@ class Thread_t
 	enum
 	{
 		Stack_32bit_val = 0xa5a5a5a5,
-		Stack_sz        = Cfg_page_sz,
+		Stack_sz        = Kcfg::Kstack_sz,
 	};
 
 public:
@@ -82,6 +85,9 @@ public:
 		Prio_min = 0,
 		Prio_max = 255,
 
+		No_timeout_idx = -1u,
+		No_cpu         = -1u,
+
 		Snd_mask = 0x10,
 		Rcv_mask = 0x20
 	};
@@ -103,6 +109,8 @@ public:
 private:
 
 	addr_t _kstack_area;
+	addr_t _kstack_mem;   // kmem va of kstack, to free it
+	unsigned _kstack_hwm; // max used kstack bytes found by kstack_hwm()
 
 	// TODO: may be enough store 'timeout' and 'partner'
 	struct Ipc_t
@@ -134,13 +142,14 @@ private:
 	};
 
 	static unsigned _counter;         // for set id
+	static Thread_t* _fpu_owner[Kcfg::Cpus_max];  // thread whose context is in FPU registers of CPU
 
 	unsigned _id;                     // XXX:  is it need?
 	addr_t _ksp;                      // kernel stack pointer
 	char _name[8];                    // thread's name for debug
 
 	unsigned _flags;                  // now use only 1 flag:  FPU=1
-	unsigned _fpu_in_use;             // is need store/restore FPU context ?
+	unsigned _fpu_in_use;             // FPU was used, context is in _float_frame or in FPU of owner CPU
 
 	Float_frame_t _float_frame __attribute__((aligned(16)));
 
@@ -162,17 +171,14 @@ private:
 	Efault_t    _efault;                  // store active exc-ipc    operation data
 
 	// sched data
-	struct InheritedPrio_t
-	{
-		L4_thrid_t owner;
-		unsigned   prio;
-		InheritedPrio_t(L4_thrid_t o, unsigned p) : owner(o), prio(p) {}
-		inline bool operator < (InheritedPrio_t other) const { return prio < other.prio; };
-	};
-	typedef list_t <InheritedPrio_t, 2> inhprios_t;
+	typedef uint32_t inh_bits_t;
+	enum { Inh_groups = (Prio_max+1) / (sizeof(inh_bits_t)*8) };
 	unsigned    _prio;                    // thread priority
-	inhprios_t  _inherited_prios;         // some threads inerit priority for prio inversion
-	L4_thrid_t  _prio_heir;               // this thread inerited selth prio to _prio_heir
+	inh_bits_t  _inh_groups;              // bit per not empty _inh_bits group
+	inh_bits_t  _inh_bits[Inh_groups];    // bit per inherited prio, as ready queue bits
+	uint16_t    _inh_cnt[Prio_max+1];     // number of blocked threads that gave us prio
+	Thread_t*   _prio_heir;               // this thread blocked by _prio_heir and gave it prio
+	unsigned    _heir_prio;               // prio given to _prio_heir, our prio_max at that time
 
 	// Wrm extention:  signal
 	bool        _signal_pending;          // flag:  is signal pending
@@ -180,6 +186,17 @@ private:
 	int         _entry_type;              // 1 - syscall, 2 - pfault, 3 - kpfault, 4 - irq
 
 	threads_t::iter_t _iter;              // iterator for current threads list
+	unsigned    _timeout_idx;             // position in timeouts heap or No_timeout_idx
+	unsigned    _cpu;                     // CPU which ready queues contain thread
+	unsigned    _cpu_migrate;             // requested CPU for running thread or No_cpu
+
+	// senders queue:  threads blocked in send phase to this thread, ordered by prio, FIFO for equal prio
+	Thread_t*   _snd_first;               // queue head, max prio sender
+	Thread_t*   _snd_last;                // queue tail
+	Thread_t*   _snd_next;                // next item in receiver queue
+	Thread_t*   _snd_prev;                // prev item in receiver queue
+	Thread_t*   _snd_dst;                 // receiver that contains this thread in queue
+	unsigned    _snd_prio;                // queue key, prio_max at enqueue time
 
 	L4_clock_t  _update_timeslice_point;  // time point
 	unsigned    _remaning_timeslice;      // time stamp
@@ -187,6 +204,10 @@ private:
 	// time accounting
 	Time_account_t _tmaccount;            // for accounting timeslice and profile
 
+	#if Cfg_krn_ipcstat
+	Ipcstat::Thr_t _ipcstat;              // IPC latency and blocked time, see ipcstat.h
+	#endif
+
 public:
 
 	void print_kstack()
@@ -197,12 +218,28 @@ public:
 		printf("\n");
 	}
 
+	// kstack is filled by pattern on activation, the lowest changed word gives max used size;
+	// words above previous result are known to be used, so repeated calls scan little
+	unsigned kstack_hwm()
+	{
+		if (!_kstack_area)
+			return _kstack_hwm;
+		const uint32_t* stk = (const uint32_t*)_kstack_area;
+		unsigned lim = (Stack_sz - _kstack_hwm) / sizeof(uint32_t);
+		for (unsigned i=0; i<lim; ++i)
+		{
+			if (stk[i] != Stack_32bit_val)
+			{
+				_kstack_hwm = Stack_sz - i * sizeof(uint32_t);
+				break;
+			}
+		}
+		return _kstack_hwm;
+	}
+
 	unsigned unused_kstack_sz()
 	{
-		for (unsigned i=0; i<Stack_sz/sizeof(uint32_t); ++i)
-			if (((uint32_t*)(_kstack_area))[i] != Stack_32bit_val)
-				return i * sizeof(uint32_t);
-		return Stack_sz;
+		return Stack_sz - kstack_hwm();
 	}
 
 	// for replacement new in list_t
@@ -212,15 +249,19 @@ public:
 		return thr;
 	}
 
-	explicit Thread_t() : _kstack_area(0), _id(_counter++), _ksp(0/*(addr_t)_kstack + sizeof(_kstack)*/), _flags(0), _fpu_in_use(0),
+	explicit Thread_t() : _kstack_area(0), _kstack_mem(0), _kstack_hwm(0), _id(_counter++), _ksp(0/*(addr_t)_kstack + sizeof(_kstack)*/), _flags(0), _fpu_in_use(0),
 	                      _task(0), _utcb_uva(-1), _utcb_kva(-1), _utcb_pa(-1),
 	                      _glob_id(L4_thrid_t::Nil), _sched_id(L4_thrid_t::Nil), _pager_id(L4_thrid_t::Nil),
 	                      _sched(0), _pager(0), _state(Idle),
 	                      _ipc(), _pfault(), _efault(),
-	                      _prio(0), _prio_heir(L4_thrid_t::Nil), _signal_pending(false),
+	                      _prio(0), _inh_groups(0), _prio_heir(0), _heir_prio(0), _signal_pending(false), _timeout_idx(No_timeout_idx),
+	                      _cpu(0), _cpu_migrate(No_cpu),
+	                      _snd_first(0), _snd_last(0), _snd_next(0), _snd_prev(0), _snd_dst(0), _snd_prio(0),
 	                      _update_timeslice_point(0), _remaning_timeslice(0), _tmaccount(_name)
 	{
 		_name[0] = 0;
+		memset(_inh_bits, 0, sizeof(_inh_bits));
+		memset(_inh_cnt, 0, sizeof(_inh_cnt));
 		//printk("Thread::ctor:  id=%d, _kstack=0x%x, sz=%u, _ksp=0x%x.\n", _id, _kstack_area, Stack_sz, _ksp);
 	}
 
@@ -239,13 +280,24 @@ public:
 	void alloc_kstack()
 	{
 		wassert(!_kstack_area && !_ksp);
-		addr_t  va = kmem_alloc(Stack_sz, Cfg_page_sz);
+		addr_t  va = kmem_alloc(Stack_sz, Stack_sz);  // page block, returned to Kmem on free
 		paddr_t pa = kmem_paddr(va, Stack_sz);
 		addr_t  new_va = Aspace::kmap_kstack(pa, Stack_sz);
-		// TODO:  Aspace::kunmap(va, Stack_sz);
+		_kstack_mem = va;
 		_kstack_area = new_va;
 	}
 
+	void free_kstack()
+	{
+		wassert(_kstack_area && _kstack_mem);
+		kstack_hwm();  // keep the last value for statistics
+		Aspace::kunmap_kstack(_kstack_area, Stack_sz);
+		kmem_free((void*)_kstack_mem);
+		_kstack_area = 0;
+		_kstack_mem = 0;
+		_ksp = 0;
+	}
+
 	void setup_kstack()
 	{
 		wassert(_kstack_area);
@@ -259,7 +311,7 @@ public:
 	inline unsigned        id()              const { return _id;       }
 	inline addr_t          ksp()             const { return _ksp;      }
 	inline addr_t          kstack_area()     const { return _kstack_area; }
-	inline size_t          kstack_sz()       const { return Stack_sz;  }
+	static inline size_t   kstack_sz()             { return Stack_sz;  }
 	inline addr_t          kentry_sp()       const { return _kstack_area + Stack_sz; }
 	inline const char*     name()            const { return _name;     }
 	inline unsigned        flags()           const { return _flags;    }
@@ -273,10 +325,15 @@ public:
 	inline Thread_t*       pager()           const { return _pager;    }
 	inline bool            is_active()       const { return _state != Inactive; }
 	inline uint8_t         prio()            const { return _prio;     }
-	inline L4_thrid_t      prio_heir()       const { return _prio_heir; }
+	inline Thread_t*       prio_heir()       const { return _prio_heir; }
 	inline bool            signal_pending()  const { return _signal_pending; }
 	inline int             entry_type()      const { return _entry_type; }
 	threads_t::iter_t      iter()            const { return _iter; }
+	inline unsigned        timeout_idx()     const { return _timeout_idx; }
+	inline unsigned        cpu()             const { return _cpu; }
+	inline unsigned        cpu_migrate()     const { return _cpu_migrate; }
+	inline Thread_t*       snd_first()       const { return _snd_first; }
+	inline Thread_t*       snd_next()        const { return _snd_next; }
 
 	inline void ksp(addr_t v)                  { _ksp        = v; }
 	inline void fpu_in_use(unsigned v)         { _fpu_in_use = v; }
@@ -286,10 +343,11 @@ public:
 	inline void pagerid(L4_thrid_t v)          { _pager_id   = v; }
 	inline void sched(Thread_t* v)             { _sched      = v; }
 	inline void pager(Thread_t* v)             { _pager      = v; }
-	inline void prio_heir(L4_thrid_t v)        { _prio_heir  = v; }
 	inline void signal_pending(bool v)         { _signal_pending = v; }
 	inline void entry_type(int v)              { _entry_type = v; }
 	inline void iter(threads_t::iter_t v)      { _iter       = v; }
+	inline void timeout_idx(unsigned v)        { _timeout_idx = v; }
+	inline void cpu_migrate(unsigned v)        { _cpu_migrate = v; }
 
 	// timeslice account
 	unsigned timeslice()               const { return _remaning_timeslice; }
@@ -321,6 +379,13 @@ public:
 	inline L4_clock_t tmspan_kwork2()             const { return _tmaccount.tmspan_kwork2(); }
 	inline L4_clock_t tmspan_kwork3()             const { return _tmaccount.tmspan_kwork3(); }
 	inline L4_clock_t tmpoint_suspend()           const { return _tmaccount.tmpoint_suspend(); }
+	inline uint64_t   cycspan_kentry()            const { return _tmaccount.cycspan_kentry(); }
+	inline uint64_t   cycspan_kwork()             const { return _tmaccount.cycspan_kwork(); }
+	inline uint64_t   cycspan_kexit()             const { return _tmaccount.cycspan_kexit(); }
+	inline uint64_t   cycspan_kwork1()            const { return _tmaccount.cycspan_kwork1(); }
+	inline uint64_t   cycspan_kwork2()            const { return _tmaccount.cycspan_kwork2(); }
+	inline uint64_t   cycspan_kwork3()            const { return _tmaccount.cycspan_kwork3(); }
+	inline unsigned   kentries_num()              const { return _tmaccount.kentries_num(); }
 	inline void       tmevent_tick(L4_clock_t c)        { return _tmaccount.tmevent_tick(c); }
 	inline void       tmevent_resume(L4_clock_t c)      { return _tmaccount.tmevent_resume(c); }
 	inline void       tmevent_kexit_start(L4_clock_t c) { return _tmaccount.tmevent_kexit_start(c); }
@@ -340,11 +405,35 @@ public:
 		if (_state == Ready)
 			_iter = threads_del_ready(_iter);
 
+		unsigned old = prio_max();
 		_prio = v;
 
 		// and add to new ready list
 		if (_state == Ready)
 			_iter = threads_add_ready(this);
+
+		prio_propagate(this, old);
+	}
+
+	void cpu(unsigned v)
+	{
+		// ready queues and timeout heaps are unique for every CPU
+		bool tmout = _timeout_idx != No_timeout_idx;
+		if (_state == Ready)
+			_iter = threads_del_ready(_iter);
+		else if (tmout  &&  _state == Send_ipc)
+			threads_del_snd_timeout_waiting(this);
+		else if (tmout)
+			threads_del_rcv_timeout_waiting(this);
+
+		_cpu = v;
+
+		if (_state == Ready)
+			_iter = threads_add_ready(this);
+		else if (tmout  &&  _state == Send_ipc)
+			threads_add_snd_timeout_waiting(this);
+		else if (tmout)
+			threads_add_rcv_timeout_waiting(this);
 	}
 
 	void flags(word_t f)
@@ -352,7 +441,7 @@ public:
 		if ((_flags & L4_flags_fpu)  &&  !(f & L4_flags_fpu))
 		{
 			// disable FPU for thread
-			fpu_in_use(false);
+			fpu_release();
 			entry_frame()->disable_fpu();
 		}
 		//force_printk_uart("flags:  0x%lx -> 0x%lx\n", _flags, f);
@@ -407,6 +496,62 @@ public:
 		//	to.raw(), to.number(), timeout.rel_usec(), _ipc.timeout);
 	}
 
+	// IPC fast path:  running thread gives CPU to waiting receiver 'dst' and waits for reply,
+	// it is state(Receive_ipc) + dst->state(Ready) without prio inheritance and sender queues,
+	// receiver of the same prio takes place of this thread in ready que
+	inline void ipc_handoff(Thread_t* dst, L4_time_t timeout, L4_thrid_t from_spec)
+	{
+		wassert(_state == Ready  &&  dst->_state == Receive_ipc);
+		wassert(!prio_heir()  &&  !dst->prio_heir());
+		wassert(timeout.is_rel());
+
+		// dst:  Receive_ipc --> Ready
+		if (dst->_timeout_idx != No_timeout_idx)
+			threads_del_rcv_timeout_waiting(dst);
+		dst->_state = Ready;
+		dst->ipcstat_block(false);
+		dst->_ipc.clear();
+		dst->_pfault.clear();
+		dst->timeslice(Kcfg::Timeslice_usec);
+		if (dst->prio_max() == prio_max()  &&  dst->cpu() == cpu())
+		{
+			dst->_iter = _iter;
+			_iter = threads_replace_ready(_iter, dst);
+		}
+		else
+		{
+			_iter = threads_del_ready(_iter);
+			dst->_iter = threads_add_ready(dst);
+		}
+
+		// this:  Ready --> Receive_ipc
+		_ipc.timeout = timeout.is_never() ? -1 : SystemClock_t::sys_clock(__func__) + timeout.rel_usec();
+		_ipc.from_spec = from_spec;
+		_state = Receive_ipc;
+		ipcstat_block(true);
+		if (_ipc.timeout != -1)
+			threads_add_rcv_timeout_waiting(this);
+	}
+
+	// IPC statistics hooks, see ipcstat.h
+	#if Cfg_krn_ipcstat
+	inline const Ipcstat::Thr_t& ipcstat() const { return _ipcstat; }
+	inline void ipcstat_entry(bool send)   { Ipcstat::syscall_entry(_ipcstat, send); }
+	inline void ipcstat_exit(bool call)    { Ipcstat::syscall_exit(_ipcstat, task()->id(), globid().number(), call); }
+	inline void ipcstat_block(bool b)      { Ipcstat::block(_ipcstat, b); }
+	inline void ipcstat_reset()            { Ipcstat::reset(_ipcstat); }
+	inline void ipcstat_transfer(const Thread_t* snd)
+	{
+		Ipcstat::transfer(_ipcstat, snd->_ipcstat, snd->task()->id(), snd->globid().number());
+	}
+	#else
+	inline void ipcstat_entry(bool)                 {}
+	inline void ipcstat_exit(bool)                  {}
+	inline void ipcstat_block(bool)                 {}
+	inline void ipcstat_reset()                     {}
+	inline void ipcstat_transfer(const Thread_t*)   {}
+	#endif
+
 	inline L4_clock_t timeout() { return _ipc.timeout; }
 
 	void pf_save(word_t fault_addr, word_t fault_access, word_t fault_inst)
@@ -432,47 +577,177 @@ public:
 
 	void inherit_prio_dump()
 	{
-		for (inhprios_t::iter_t it=_inherited_prios.begin(); it!=_inherited_prios.end(); ++it)
-			printk("inh_prio_dump:  owner=%u, prio=%u.\n", it->owner.number(), it->prio);
+		for (unsigned p=0; p<=Prio_max; ++p)
+			if (_inh_cnt[p])
+				printk("inh_prio_dump:  prio=%u, owners=%u.\n", p, _inh_cnt[p]);
 	}
 
-	inline inhprios_t::iter_t inherit_prio_find(L4_thrid_t owner)
+private:
+
+	inline void inherit_prio_add(unsigned p)
 	{
-		for (inhprios_t::iter_t it=_inherited_prios.begin(); it!=_inherited_prios.end(); ++it)
-			if (it->owner == owner)
-				return it;
-		return _inherited_prios.end();
+		if (!_inh_cnt[p]++)
+		{
+			unsigned group = p / (sizeof(inh_bits_t)*8);
+			_inh_bits[group] |= 1 << (p - group * (sizeof(inh_bits_t)*8));
+			_inh_groups |= 1 << group;
+		}
 	}
 
-	void inherit_prio_add(L4_thrid_t owner, unsigned priority)
+	inline void inherit_prio_del(unsigned p)
 	{
-		printk("inh_prio_add:  iam=%u:  owner=%u, prio=%u, inh_prio_list_sz=%zu.\n",
-			globid().number(), owner.number(), priority, _inherited_prios.size());
-		wassert(owner != globid());
-		wassert(inherit_prio_find(owner) == _inherited_prios.end());
-		_inherited_prios.insert_sort(InheritedPrio_t(owner, priority));
+		wassert(_inh_cnt[p]);
+		if (!--_inh_cnt[p])
+		{
+			unsigned group = p / (sizeof(inh_bits_t)*8);
+			_inh_bits[group] &= ~(1 << (p - group * (sizeof(inh_bits_t)*8)));
+			if (!_inh_bits[group])
+				_inh_groups &= ~(1 << group);
+		}
 	}
 
-	void inherit_prio_del(L4_thrid_t owner, unsigned priority)
+	// ready list is selected by prio_max, move ready thread to the list of new prio
+	void inherit_prio_change(int del, int add)
 	{
-		printk("inh_prio_del:  iam=%u:  owner=%u, prio=%u, inh_prio_list_sz=%zu.\n",
-			globid().number(), owner.number(), priority, _inherited_prios.size());
-		(void) priority;
-		inhprios_t::iter_t it = inherit_prio_find(owner);
-		wassert(owner != globid());
-		wassert(it != _inherited_prios.end());
-		wassert(it->prio == priority);
-		_inherited_prios.erase(it);
+		if (_state == Ready)
+			_iter = threads_del_ready(_iter);
+		if (del >= 0)
+			inherit_prio_del(del);
+		if (add >= 0)
+			inherit_prio_add(add);
+		if (_state == Ready)
+			_iter = threads_add_ready(this);
 	}
 
-	inline unsigned prio_max()
+	// prio_max of 't' was 'old', pass new value along the chain of blocked threads;
+	// it stops on unchanged prio_max, so deadlock cycles are passed once
+	static void prio_propagate(Thread_t* t, unsigned old)
 	{
-		if (_inherited_prios.empty())
+		while (t->prio_max() != old)
+		{
+			t->snd_requeue();
+			Thread_t* heir = t->_prio_heir;
+			if (!heir)
+				break;
+			old = heir->prio_max();
+			unsigned prev = t->_heir_prio;
+			t->_heir_prio = t->prio_max();
+			heir->inherit_prio_change(prev, t->_heir_prio);
+			t = heir;
+		}
+	}
+
+public:
+
+	// this thread is going to block on 'heir', give it our prio
+	void prio_inherit(Thread_t* heir)
+	{
+		printk("inh_prio_add:  iam=%u:  heir=%u, prio=%u.\n",
+			globid().number(), heir->globid().number(), prio_max());
+		wassert(!_prio_heir  &&  heir != this);
+		unsigned old = heir->prio_max();
+		_prio_heir = heir;
+		_heir_prio = prio_max();
+		heir->inherit_prio_change(-1, _heir_prio);
+		prio_propagate(heir, old);
+	}
+
+	// this thread isn't blocked on heir anymore
+	void prio_disinherit()
+	{
+		printk("inh_prio_del:  iam=%u:  heir=%u, prio=%u.\n",
+			globid().number(), _prio_heir->globid().number(), _heir_prio);
+		wassert(_prio_heir);
+		Thread_t* heir = _prio_heir;
+		unsigned old = heir->prio_max();
+		heir->inherit_prio_change(_heir_prio, -1);
+		_prio_heir = 0;
+		prio_propagate(heir, old);
+	}
+
+	// max of own and inherited prio, inherited one is found by bitmaps as highest ready prio
+	unsigned prio_max() const
+	{
+		if (!_inh_groups)
 			return _prio;
-		unsigned inh_max = _inherited_prios.back().prio;
+		unsigned group = Proc::msb(_inh_groups);
+		unsigned inh_max = sizeof(inh_bits_t)*8*group + Proc::msb(_inh_bits[group]);
 		return max(_prio, inh_max);
 	}
 
+	// insert to receiver queue after all senders with greater or equal prio
+	void snd_enqueue(Thread_t* dst)
+	{
+		wassert(!_snd_dst);
+		_snd_dst = dst;
+		_snd_prio = prio_max();
+
+		// search from tail, for equal prio it is O(1)
+		Thread_t* pos = dst->_snd_last;
+		while (pos  &&  pos->_snd_prio < _snd_prio)
+			pos = pos->_snd_prev;
+
+		_snd_prev = pos;
+		_snd_next = pos ? pos->_snd_next : dst->_snd_first;
+		if (_snd_next)
+			_snd_next->_snd_prev = this;
+		else
+			dst->_snd_last = this;
+		if (pos)
+			pos->_snd_next = this;
+		else
+			dst->_snd_first = this;
+	}
+
+	void snd_dequeue()
+	{
+		if (!_snd_dst)
+			return;  // receiver was deleted
+		if (_snd_prev)
+			_snd_prev->_snd_next = _snd_next;
+		else
+			_snd_dst->_snd_first = _snd_next;
+		if (_snd_next)
+			_snd_next->_snd_prev = _snd_prev;
+		else
+			_snd_dst->_snd_last = _snd_prev;
+		_snd_next = 0;
+		_snd_prev = 0;
+		_snd_dst = 0;
+	}
+
+	// keep queue order if prio of blocked sender was changed
+	void snd_requeue()
+	{
+		if (!_snd_dst  ||  _snd_prio == prio_max())
+			return;
+		Thread_t* dst = _snd_dst;
+		snd_dequeue();
+		snd_enqueue(dst);
+	}
+
+	// set error of send phase to utcb, thread is woken by caller
+	void snd_fail(int err)
+	{
+		L4_utcb_t* u = utcb();
+		u->ipc_error_code(L4_ipcerr_t(L4_snd_phase, err));
+		L4_msgtag_t tag = u->msgtag();
+		tag.ipc_set_failed();
+		u->msgtag(tag);
+	}
+
+	// receiver is deleted, cancel IPC of blocked senders
+	void snd_queue_detach()
+	{
+		while (Thread_t* t = _snd_first)
+		{
+			printk("%s:  %u:  cancel send of %u.\n", _name, globid().number(), t->globid().number());
+			t->snd_fail(L4_ipc_canceled);
+			t->state(Ready);  // dequeues 't' and removes its timeout
+		}
+		wassert(!_snd_last);
+	}
+
 	bool is_good_sender(const Thread_t* snd, bool* use_local_id) const
 	{
 		wassert(state() == Receive_ipc);
@@ -515,8 +790,12 @@ public:
 		wassert(_utcb_pa && "activate:  no utcb location.");
 		wassert(_task->is_configured() && "activate:  aspace has not been configured.");
 
+		// kstack is needed only for running thread
+		alloc_kstack();
+		setup_kstack();
+
 		// map utcb
-		addr_t utcb_uva = task()->alloc_utcb_uspace();
+		addr_t utcb_uva = task()->alloc_utcb_uspace(this);
 		wassert(utcb_uva);
 		_task->map(utcb_uva, _utcb_pa, Cfg_page_sz, Acc_utcb, Cachable);
 		_utcb_uva = utcb_uva;
@@ -558,18 +837,36 @@ public:
 		printk("%s:  %u:  state:  %s -> %s.\n", _name, globid().number(), state_str(), state_str(s));
 		wassert(_state != s);
 
+		// partner of send phase may be deleted, fail IPC instead of blocking
+		Thread_t* dst = (s & Snd_mask) ? threads_find(_ipc.to) : 0;
+		if ((s & Snd_mask)  &&  !dst)
+		{
+			printk("%s:  %u:  no send partner %u.\n", _name, globid().number(), _ipc.to.number());
+			snd_fail(L4_ipc_no_partner);
+			if (_state == Ready)
+			{
+				if (_prio_heir)
+					prio_disinherit();
+				return;
+			}
+			s = Ready;
+		}
+
+		state_t old = _state;
+
 		// delete from cur sched-list if need
 		if (_state == Ready)
 			_iter = threads_del_ready(_iter);
 		else
-		if (_state == Send_ipc  &&  _ipc.timeout != -1)
-			_iter = threads_del_snd_timeout_waiting(_iter);
-		else
-		if (_state == Send_ipc  /**/ || _state==Send_pfault || _state==Send_exception /*~*/)
-			_iter = threads_del_send(_iter);
+		if (_state & Snd_mask)
+		{
+			if (_timeout_idx != No_timeout_idx)
+				threads_del_snd_timeout_waiting(this);
+			snd_dequeue();
+		}
 		else
-		if (_state == Receive_ipc  &&  _ipc.timeout != -1)
-			_iter = threads_del_rcv_timeout_waiting(_iter);
+		if (_state == Receive_ipc  &&  _timeout_idx != No_timeout_idx)
+			threads_del_rcv_timeout_waiting(this);
 
 		_state = s;
 
@@ -579,26 +876,37 @@ public:
 			_ipc.clear();
 			_pfault.clear();
 			timeslice(Kcfg::Timeslice_usec);
+			if (_cpu_migrate != No_cpu  &&  this != cur_thr())
+			{
+				// postponed migration of thread that was running on other CPU
+				_cpu = _cpu_migrate;
+				_cpu_migrate = No_cpu;
+			}
 			_iter = threads_add_ready(this);
 		}
 		else
-		if (s == Send_ipc  &&  _ipc.timeout != -1)
-			_iter = threads_add_snd_timeout_waiting(this);
-		else
-		if (s == Send_ipc /**/ || s==Send_pfault || s==Send_exception /*~*/)
-			_iter = threads_add_send(this);
+		if (s & Snd_mask)
+		{
+			snd_enqueue(dst);  // dst is found by global id or local id of current task
+			if (s == Send_ipc  &&  _ipc.timeout != -1)
+				threads_add_snd_timeout_waiting(this);
+		}
 		else
 		if (s == Receive_ipc  &&  _ipc.timeout != -1)
-			_iter = threads_add_rcv_timeout_waiting(this);
-
-		// remove inherited prio if need
-		if (!prio_heir().is_nil())
+			threads_add_rcv_timeout_waiting(this);
+		else
+		if (s == Idle)
 		{
-			Thread_t* thr = threads_find(prio_heir());
-			wassert(thr);
-			thr->inherit_prio_del(globid(), prio_max());
-			prio_heir(L4_thrid_t::Nil);
+			snd_queue_detach();
+			fpu_release();
+			ipcstat_reset();
 		}
+
+		// blocking IPC is finished, return inherited prio
+		if (_prio_heir  &&  (old == Send_ipc  ||  old == Receive_ipc))
+			prio_disinherit();
+
+		ipcstat_block(s == Send_ipc  ||  s == Receive_ipc);
 	}
 
 	inline L4_utcb_t* uutcb() const { return (L4_utcb_t*) _utcb_uva; }  // used for intra aspace access
@@ -642,6 +950,7 @@ public:
 
 	static void user_invoke()
 	{
+		Smp::unlock();  // new thread goes to user mode without kernel exit path
 		arch_user_invoke();
 	}
 
@@ -660,30 +969,77 @@ public:
 		Stack::push(&_ksp, (word_t)user_invoke); // context_switch() will use it from the stack
 	}
 
-	void store_floats()
+	// Lazy FPU switching:  FPU registers keep context of the owner until other thread uses FPU.
+	// Only owner has FPU enabled in its entry frame, others get fpu-disabled trap on first use.
+	static Thread_t* fpu_owner() { return _fpu_owner[Smp::cpu()]; }
+
+	// fpu-disabled trap from this thread with FPU permission
+	void fpu_acquire()
 	{
-		if (fpu_in_use()  /*TESTME*/ &&  entry_frame()->is_fpu_enabled()/*~TESTME*/)
-			arch_store_floats(&_float_frame);
+		Thread_t* owner = fpu_owner();
+		if (owner != this)
+		{
+			if (owner)
+			{
+				arch_store_floats(&owner->_float_frame);
+				owner->entry_frame()->disable_fpu();
+			}
+			if (!fpu_in_use())
+				memset(&_float_frame, 0, sizeof(_float_frame));  // first use, don't leak old regs
+			arch_restore_floats(&_float_frame);
+			_fpu_owner[Smp::cpu()] = this;
+		}
+		fpu_in_use(true);
+		entry_frame()->enable_fpu();
 	}
 
-	void restore_floats()
+	// forget FPU context if thread lost FPU permission or was deleted,
+	// thread may own FPU of other CPU (deleted by other CPU) and TCB will be freed
+	void fpu_release()
 	{
-		if (fpu_in_use())
-			arch_restore_floats(&_float_frame);
+		for (unsigned i=0; i<Kcfg::Cpus_max; ++i)
+			if (_fpu_owner[i] == this)
+				_fpu_owner[i] = 0;
+		fpu_in_use(false);
+	}
+
+	// SMP:  thread may be migrated by other CPU while it is switched out, and FPU registers
+	// of this CPU can't be stored remotely, so store them when owner leaves the CPU
+	void fpu_save()
+	{
+		if (Kcfg::Cpus_max > 1  &&  fpu_owner() == this)
+		{
+			arch_store_floats(&_float_frame);
+			entry_frame()->disable_fpu();
+			_fpu_owner[Smp::cpu()] = 0;
+		}
 	}
 
 	void context_switch(Thread_t* next);
 };
 
 //--------------------------------------------------------------------------------------------------
+// Wrm extention:  interrupt coalescing, set by handler for high-rate devices.
+//   events <= 1 - after ack irq stays masked until 'usec' passed since last notification, device
+//                 accumulates work and one notification covers it;
+//   events > 1  - for edge irqs:  kernel acks and counts interrupts itself, handler is notified
+//                 on 'events'-th interrupt or 'usec' after the first counted one.
+// Holds are checked on timer tick, so real interval is rounded up to tick in tick mode.
 class Int_thread_t
 {
 	unsigned   _intno;         // int number
 	L4_thrid_t _globid;        // int thread id
 	L4_thrid_t _handler;       // global id
 	bool       _pending;       // is interrupt happens?
+	unsigned   _events;        // interrupts since last notification
+	unsigned   _coal_usec;     // coalescing interval, 0 - off
+	unsigned   _coal_events;   // interrupts per notification
+	L4_clock_t _last;          // time of last notification
+	L4_clock_t _hold;          // hold expiry time, 0 - not held
+	bool       _eoi_done;      // delivered irq is already EOI'd (flush of counted interrupts)
 
 	static unsigned _counter;  // to set int number
+	static unsigned _held;     // number of held interrupts
 
 public:
 
@@ -691,23 +1047,92 @@ public:
 		_intno(_counter++),
 		_globid(L4_thrid_t::create_irq(_intno)),
 		_handler(L4_thrid_t::Nil),
-		_pending(false) {}
+		_pending(false),
+		_events(0),
+		_coal_usec(0),
+		_coal_events(0),
+		_last(0),
+		_hold(0),
+		_eoi_done(false) {}
 
 	inline void handler(L4_thrid_t h)
 	{
 		wassert(h.is_nil() || thrid_is_global_user(h));
 		_handler = h;
 		_pending = false;
+		_events = 0;
+		_eoi_done = false;
+		coalesce(0, 0);
 		if (h.is_nil())
 			Intc::mask(_intno);
 	}
 
+	inline void coalesce(unsigned usec, unsigned events)
+	{
+		release();
+		_coal_usec = usec;
+		_coal_events = usec ? events : 0;  // counted interrupts need flush time
+	}
+
+	// count interrupt, return true if handler should be notified now
+	inline bool event()
+	{
+		_events++;
+		if (_coal_events <= 1  ||  _events >= _coal_events)
+			return true;
+		if (!_hold)
+			hold(SystemClock_t::sys_clock(__func__) + _coal_usec);
+		return false;
+	}
+
+	// take count of interrupts for notification
+	inline unsigned notify()
+	{
+		unsigned n = _events ? _events : 1;
+		_events = 0;
+		release();
+		if (_coal_usec)
+			_last = SystemClock_t::sys_clock(__func__);
+		return n;
+	}
+
+	// on ack, return true if irq should stay masked
+	inline bool hold_on_ack()
+	{
+		if (_coal_events > 1  ||  !_coal_usec)
+			return false;
+		L4_clock_t end = _last + _coal_usec;
+		if (SystemClock_t::sys_clock(__func__) >= end)
+			return false;
+		hold(end);
+		return true;
+	}
+
+	inline void hold(L4_clock_t end)
+	{
+		if (!_hold)
+			_held++;
+		_hold = end;
+	}
+
+	inline void release()
+	{
+		if (_hold)
+			_held--;
+		_hold = 0;
+	}
+
 	inline void pending(bool p)       { _pending = p;              }
+	inline void eoi_done(bool v)      { _eoi_done = v;             }
+	inline bool eoi_done()      const { return _eoi_done;          }
 	inline unsigned intno()     const { return _intno;             }
 	inline L4_thrid_t globid()  const { return _globid;            }
 	inline L4_thrid_t handler() const { return _handler;           }
 	inline bool is_active()     const { return !_handler.is_nil(); }
 	inline bool is_pending()    const { return _pending;           }
+	inline bool is_counting()   const { return _coal_events > 1;   }
+	inline L4_clock_t hold()    const { return _hold;              }
+	static inline unsigned held()     { return _held;              }
 };
 
 #endif // THREAD_H
@@ -10,7 +10,10 @@
 #include "krn-config.h"
 #include "kconfig.h"
 #include "thread.h"
+#include "timeouts.h"
 #include "sched.h"
+#include "slab.h"
+#include "ktrace.h"
 #include "l4_kdbops.h"
 #include "l4_ipcerr.h"
 
@@ -24,18 +27,22 @@ class Threads_t
 	};
 
 	static Int_thread_t _int_threads [Kcfg::Ints_max];
-	static Thread_t     _threads     [Kcfg::Threads_max];
+	static Thread_t*    _threads     [Kcfg::Threads_max];  // 0 - free thread number
+	static Slab_t       _tcbs;                             // TCBs are allocated on thread creation
+	static unsigned     _kstack_hwm;                       // max kstack usage of deleted threads
 
 	typedef uint32_t bits_t;
-	static bits_t    _ready_bits[(Thread_t::Prio_max+1) / (sizeof(bits_t)*8)];
-	static threads_t _ready_threads[Thread_t::Prio_max+1]; // threads by prio
-	static threads_t _send_threads;                        // send ipc threads with infinity timeout
-	static threads_t _timeout_waiting_snd_threads;         // threads ordered by expire time and prio
-	static threads_t _timeout_waiting_rcv_threads;         // threads ordered by expire time and prio
+	enum { Bits_groups = (Thread_t::Prio_max+1) / (sizeof(bits_t)*8) };
+	static bits_t    _ready_groups[Kcfg::Cpus_max];                        // bit per not empty _ready_bits group
+	static bits_t    _ready_bits[Kcfg::Cpus_max][Bits_groups];             // bit per not empty ready que
+	static threads_t _ready_threads[Kcfg::Cpus_max][Thread_t::Prio_max+1]; // threads by prio
+	static Timeouts_t _timeout_waiting_snd_threads[Kcfg::Cpus_max];  // threads ordered by expire time and prio
+	static Timeouts_t _timeout_waiting_rcv_threads[Kcfg::Cpus_max];  // threads ordered by expire time and prio
 
 private:
 
 	static_assert((Thread_t::Prio_max+1) % (sizeof(bits_t)*8) == 0);
+	static_assert(Bits_groups <= sizeof(bits_t)*8);
 	static const char* separated_str(unsigned long long val)
 	{
 		static char str[32];
@@ -48,10 +55,19 @@ private:
 		return str;
 	}
 
-	static threads_t* ready_threads(unsigned prio)
+	// ready queues are short, take items by small chanks
+	static void* ready_list_malloc(size_t sz_req, size_t* sz_rep)
 	{
+		enum { Chank_items = 8 };
+		*sz_rep = Chank_items * sz_req;
+		return (void*) kmem_alloc(*sz_rep, sizeof(word_t));
+	}
+
+	static threads_t* ready_threads(unsigned cpu, unsigned prio)
+	{
+		wassert(cpu < Kcfg::Cpus_max);
 		wassert(prio <= Thread_t::Prio_max);
-		return &_ready_threads[prio];
+		return &_ready_threads[cpu][prio];
 	}
 
 public:
@@ -61,11 +77,13 @@ public:
 		L4_clock_t now = SystemClock_t::sys_clock(__func__);
 		L4_clock_t exec = 0;
 
-		printf("  ##   id  name  task  prio/max  cpu,%%  state           partner       no-act,us  signal\n");
+		unsigned kstack_hwm = _kstack_hwm;
+
+		printf("  ##   id  name  task  prio/max  cpu,%%  state           partner       no-act,us  signal  kstk\n");
 		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]); ++i)
 		{
-			Thread_t* it = _threads + i;
-			if (it->state() == Thread_t::Idle)
+			Thread_t* it = _threads[i];
+			if (!it)
 				continue;
 
 			char partner[16] = "";
@@ -87,12 +105,16 @@ public:
 
 			unsigned long long no_activity_us = Sched_t::current()==&*it ? 0 : (now - it->tmpoint_suspend());
 
-			printf(" %3d  %3d  %4s    %2u   %3u/%3u   %2u.%u  %-14s  %7s  %14s  %6d\n",
+			unsigned kstack_used = it->kstack_hwm();
+			kstack_hwm = max(kstack_hwm, kstack_used);
+
+			printf(" %3d  %3d  %4s    %2u   %3u/%3u   %2u.%u  %-14s  %7s  %14s  %6d  %4u\n",
 					it->id(), it->globid().number(), it->name(), it->task()->id(), it->prio(),
 					it->prio_max(), promile/10, promile%10, it->state_str(), partner,
-					separated_str(no_activity_us), it->signal_pending());
+					separated_str(no_activity_us), it->signal_pending(), kstack_used);
 		}
 		printf("\n");
+		printf(" kstack,b:     %u max used of %zu\n", kstack_hwm, Thread_t::kstack_sz());
 		printf(" uptime,us:    %s\n", separated_str(now));
 		printf(" exectime,us:  %s\n", separated_str(exec));
 		printf(" diff,us:      %s\n", separated_str(now - exec));
@@ -107,8 +129,8 @@ public:
 		       "     1,%%   2,%%   3,%%\n");
 		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]); ++i)
 		{
-			Thread_t* it = _threads + i;
-			if (it->state() == Thread_t::Idle)
+			Thread_t* it = _threads[i];
+			if (!it)
 				continue;
 			unsigned all    = 10000 * it->tmspan_exec()   / now;
 			unsigned usr    = 10000 * it->tmspan_uexec()  / now;
@@ -128,6 +150,23 @@ public:
 					kentry/100, kentry%100, kwork/100, kwork%100, kexit/100, kexit%100,
 					kwork1/100, kwork1%100, kwork2/100, kwork2%100, kwork3/100, kwork3%100);
 		}
+
+		#if !defined(Cfg_arch_sparc)  // no cycle counter
+		printf("\n %3s  %3s  %4s  %9s  %7s  %7s  %7s  %7s  %7s  %7s   <-- cycles per kernel entry\n",
+		       "##", "id", "name", "kentries", "kentr", "kwork", "kexit", "1", "2", "3");
+		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]); ++i)
+		{
+			Thread_t* it = _threads[i];
+			if (!it  ||  !it->kentries_num())
+				continue;
+			unsigned n = it->kentries_num();
+			printf(" %3d  %3d  %4s  %9u  %7llu  %7llu  %7llu  %7llu  %7llu  %7llu\n",
+					it->id(), it->globid().number(), it->name(), n,
+					it->cycspan_kentry() / n, it->cycspan_kwork() / n, it->cycspan_kexit() / n,
+					it->cycspan_kwork1() / n, it->cycspan_kwork2() / n, it->cycspan_kwork3() / n);
+		}
+		#endif
+
 		printf("\n");
 		printf(" uptime,us:    %s\n", separated_str(now));
 		printf(" exectime,us:  %s\n", separated_str(exec));
@@ -141,8 +180,8 @@ public:
 
 		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]) && cnt!=sz; ++i)
 		{
-			Thread_t* it = _threads + i;
-			if (it->state() == Thread_t::Idle)
+			Thread_t* it = _threads[i];
+			if (!it)
 				continue;
 
 			threads[cnt].id               = it->globid().number();
@@ -150,6 +189,8 @@ public:
 			threads[cnt].thr_uptime_usec  = it->tmspan_exec();
 			threads[cnt].sys_uptime_usec  = now;
 			threads[cnt].no_activity_usec = Sched_t::current()==&*it ? 0 : now - it->tmpoint_suspend();
+			threads[cnt].kstack_sz        = it->kstack_sz();
+			threads[cnt].kstack_used      = it->kstack_hwm();
 			strncpy(threads[cnt].name, it->name(), 8);
 			cnt++;
 		}
@@ -161,8 +202,8 @@ public:
 	{
 		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]); ++i)
 		{
-			Thread_t* t = _threads + i;
-			if (t->task() == tsk)
+			Thread_t* t = _threads[i];
+			if (t  &&  t->task() == tsk)
 			{
 				paddr_t utcb_pa = tsk->walk((addr_t)t->kutcb(), Cfg_page_sz);
 				tsk->map((addr_t)t->uutcb(), utcb_pa, Cfg_page_sz, Acc_utcb, Cachable);
@@ -170,12 +211,12 @@ public:
 		}
 	}
 
-	static void alloc_kstack()
+	// ready queues take items from Kmem, it must be inited
+	static void init()
 	{
-		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]); ++i)
-		{
-			_threads[i].alloc_kstack();
-		}
+		for (unsigned cpu=0; cpu<Kcfg::Cpus_max; ++cpu)
+			for (unsigned prio=0; prio<=Thread_t::Prio_max; ++prio)
+				_ready_threads[cpu][prio].set_allocator(ready_list_malloc);
 	}
 
 	static Int_thread_t* int_thread(unsigned irq)
@@ -188,8 +229,10 @@ public:
 	{
 		printk("new thread:  id=%u, prio=%u, name=%s.\n", globid.number(), prio, name);
 		wassert(globid.number() >= Thread_number_min  &&  globid.number() <= Thread_number_max);
-		Thread_t* thr = &_threads[globid.number() - Thread_number_min];
-		wassert(thr->state() == Thread_t::Idle);
+		Thread_t*& slot = _threads[globid.number() - Thread_number_min];
+		wassert(!slot);
+		Thread_t* thr = new ((Thread_t*)_tcbs.alloc()) Thread_t;
+		slot = thr;
 		thr->task(tsk);
 		thr->name(name);
 		thr->globid(globid);
@@ -197,7 +240,6 @@ public:
 		thr->pagerid(pager);
 		thr->prio(prio);
 		thr->state(Thread_t::Inactive);
-		thr->setup_kstack();
 		return thr;
 	}
 
@@ -206,15 +248,32 @@ public:
 	{
 		printk("del thread:  thrid=%u.\n", globid.number());
 		wassert(globid.number() >= Thread_number_min  &&  globid.number() <= Thread_number_max);
-		Thread_t* thr = &_threads[globid.number() - Thread_number_min];
+		Thread_t*& slot = _threads[globid.number() - Thread_number_min];
+		Thread_t* thr = slot;
+		wassert(thr  &&  thr != Sched_t::current());
 		thr->state(Thread_t::Idle);
+		// threads blocked on deleted one keep their prio
+		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]); ++i)
+			if (_threads[i]  &&  _threads[i]->prio_heir() == thr)
+				_threads[i]->prio_disinherit();
+		if (thr->kstack_area())
+		{
+			thr->free_kstack();
+			_kstack_hwm = max(_kstack_hwm, thr->kstack_hwm());
+		}
+		thr->~Thread_t();
+		_tcbs.free(thr);
+		slot = 0;
 	}
 
-	// create kernel thread
-	static void create_kthread_and_go(void* entry_point, Task_t* tsk, const char* name) __attribute__((noreturn))
+	// create kernel thread, it will be idle thread of the cpu
+	static void create_kthread_and_go(void* entry_point, Task_t* tsk, const char* name, unsigned cpu = 0) __attribute__((noreturn))
 	{
-		L4_thrid_t globid = L4_thrid_t::create_global(get_kip()->thread_info.system_base());
+		L4_thrid_t globid = L4_thrid_t::create_global(get_kip()->thread_info.system_base() + cpu);
 		Thread_t* thr = create(globid, globid, globid, tsk, Thread_t::Prio_min, name);
+		thr->alloc_kstack();
+		thr->setup_kstack();
+		thr->cpu(cpu);
 		thr->state(Thread_t::Ready);
 		thr->tmevent_resume(SystemClock_t::sys_clock(__func__));
 		Sched_t::current(thr);
@@ -225,23 +284,17 @@ public:
 	{
 		if (thrid_num >= Thread_number_min  &&  thrid_num <= Thread_number_max)
 		{
-			Thread_t* t = &_threads[thrid_num - Thread_number_min];
-			return t->state() == Thread_t::Idle ? 0 : t;
+			return _threads[thrid_num - Thread_number_min];
 		}
 		return 0;
 	}
 
-	// XXX:  It need to find by local ID.
-	//       NOTE:  My kernel implementation works faster with global ID,
-	//              may be need discard works with local ID inside kernel?
+	// local ID is user utcb address, task keeps thread per utcb slot
 	static Thread_t* find_by_utcb(addr_t utcb)
 	{
-		for (unsigned i=0; i<sizeof(_threads)/sizeof(_threads[i]); ++i)
-		{
-			Thread_t* t = _threads + i;
-			if (t->task() == Sched_t::current()->task()  &&  utcb == (addr_t)t->uutcb())
-				return t->state() == Thread_t::Idle ? 0 : t;
-		}
+		Thread_t* t = Sched_t::current()->task()->utcb_thread(utcb);
+		if (t)
+			return t->state() == Thread_t::Idle ? 0 : t;
 		dump();
 		panic("%s:  no thread with such utcb=0x%lx.\n", __func__, utcb);
 		return 0;
@@ -312,29 +365,7 @@ public:
 		return true;
 	}
 
-private:
-
-	static Thread_t* find_highest_prio_sender(threads_t* list, const Thread_t* rcv, L4_thrid_t from_spec,
-	                                   bool* propagated, bool* use_local_id)
-	{
-		Thread_t* res = 0;
-		for (threads_t::iter_t it=list->begin(); it!=list->end(); ++it)
-		{
-			//printk("%s:  thr=%s, state=%s.\n", __func__, (*it)->name(), (*it)->state_str());
-
-			if (!_is_good_sender(*rcv, from_spec, *it, propagated, use_local_id))
-				continue;
-
-			if (!res  ||  res->prio_max() < (*it)->prio_max())
-				res = *it;
-		}
-		return res;
-	}
-
-public:
-
 	// find partner for receive thread
-	// TODO:  find max prio thread
 	static Thread_t* find_sender(const Thread_t& rcv, L4_thrid_t from_spec, bool* propagated, bool* use_local_id)
 	{
 		*propagated = false;
@@ -354,34 +385,17 @@ public:
 			return t;
 		}
 
-		// if receiver wants any or any_local thread
-		bool prop_1  = false;
-		bool prop_2  = false;
-		bool locid_1 = false;
-		bool locid_2 = false;
-		Thread_t* snd1 = find_highest_prio_sender(&_timeout_waiting_snd_threads, &rcv, from_spec, &prop_1, &locid_1);
-		Thread_t* snd2 = find_highest_prio_sender(&_send_threads, &rcv, from_spec, &prop_2, &locid_2);
-
-		if (snd1 && snd2)
+		// if receiver wants any or any_local thread - senders queue is ordered by prio,
+		// first good sender is the highest prio one
+		for (Thread_t* snd=rcv.snd_first(); snd; snd=snd->snd_next())
 		{
-			if (snd1->prio_max() < snd2->prio_max())
-				snd1 = 0;
-			else
-				snd2 = 0;
-		}
-
-		if (snd1)
-		{
-			*propagated = prop_1;
-			*use_local_id = locid_1;
-			return snd1;
-		}
-
-		if (snd2)
-		{
-			*propagated = prop_2;
-			*use_local_id = locid_2;
-			return snd2;
+			bool prop = false;
+			bool locid = false;
+			if (!_is_good_sender(rcv, from_spec, snd, &prop, &locid))
+				continue;
+			*propagated = prop;
+			*use_local_id = locid;
+			return snd;
 		}
 
 		return 0;
@@ -400,36 +414,54 @@ public:
 
 	static threads_t::iter_t add_ready(Thread_t* thr)
 	{
-		unsigned prio = thr->prio();
-		threads_t* que = ready_threads(prio);
+		unsigned cpu = thr->cpu();
+		unsigned prio = thr->prio_max();  // inherited prio is applied to ready list
+		threads_t* que = ready_threads(cpu, prio);
 		wassert(!is_exist(que, thr));
 		que->push_back(thr);
 		unsigned bits_group = prio / (sizeof(bits_t)*8);
-		_ready_bits[bits_group] |= 1 << (prio - bits_group * (sizeof(bits_t)*8));
+		_ready_bits[cpu][bits_group] |= 1 << (prio - bits_group * (sizeof(bits_t)*8));
+		_ready_groups[cpu] |= 1 << bits_group;
+
+		// other CPU will check its queues by ipi
+		if (cpu != Smp::cpu()  &&  Smp::is_online(cpu))
+			Smp::send_ipi(cpu, Smp::Ipi_resched);
+
 		return que->last();
 	}
 
 	static threads_t::iter_t del_ready(threads_t::iter_t it)
 	{
-		unsigned prio = (*it)->prio();
-		threads_t* que = ready_threads(prio);
+		unsigned cpu = (*it)->cpu();
+		unsigned prio = (*it)->prio_max();
+		threads_t* que = ready_threads(cpu, prio);
 		wassert(is_exist(que, it));
 		que->erase(it);
 		if (que->empty())
 		{
 			unsigned bits_group = prio / (sizeof(bits_t)*8);
-			_ready_bits[bits_group] &= ~(1 << (prio - bits_group * (sizeof(bits_t)*8)));
+			_ready_bits[cpu][bits_group] &= ~(1 << (prio - bits_group * (sizeof(bits_t)*8)));
+			if (!_ready_bits[cpu][bits_group])
+				_ready_groups[cpu] &= ~(1 << bits_group);
 		}
 		return que->end();
 	}
 
+	// put thr to the place of ready thread 'it' of the same que, bitmaps are not changed
+	static threads_t::iter_t replace_ready(threads_t::iter_t it, Thread_t* thr)
+	{
+		wassert((*it)->cpu() == thr->cpu()  &&  (*it)->prio_max() == thr->prio_max());
+		*it = thr;
+		return ready_threads(thr->cpu(), thr->prio_max())->end();
+	}
+
 	// replace cur thread at the end of que and set new timeslice
 	static threads_t::iter_t timeslice_expired(Thread_t* thr, threads_t* que = 0)
 	{
 		wassert(!thr->timeslice());
 		wassert(thr->state() == Thread_t::Ready);
 		if (!que)
-			que = ready_threads(thr->prio());
+			que = ready_threads(thr->cpu(), thr->prio_max());
 		thr->timeslice(Kcfg::Timeslice_usec);
 		threads_t::iter_t it = thr->iter();
 		if (que->size() > 1)
@@ -442,80 +474,47 @@ public:
 		return que->begin();
 	}
 
-	// get next Ready thread
-	static Thread_t* get_highest_prio_ready_thread()
+	// max prio of Ready threads, constant time:  group by summary word, prio inside group
+	static unsigned highest_ready_prio(unsigned cpu = Smp::cpu())
 	{
-		// find max prio thread
-		for (int i=sizeof(_ready_bits)/sizeof(_ready_bits[0])-1; i>=0; --i)
-		{
-			if (_ready_bits[i])
-			{
+		if (!_ready_groups[cpu])
+			panic("no ready threads");
+		unsigned group = Proc::msb(_ready_groups[cpu]);
+		return sizeof(bits_t)*8*group + Proc::msb(_ready_bits[cpu][group]);
+	}
+
+	// previous bit by bit search, it is used as reference by kdb 'sched' benchmark
+	static unsigned highest_ready_prio_linear(unsigned cpu = Smp::cpu())
+	{
+		for (int i=Bits_groups-1; i>=0; --i)
+			if (_ready_bits[cpu][i])
 				for (int j=sizeof(bits_t)*8-1; j>=0; --j)
-				{
-					if ((_ready_bits[i] >> j) & 0x1)
-					{
-						unsigned prio = sizeof(bits_t)*8*i + j;
-						threads_t* que = ready_threads(prio);
-						wassert(que->size());
-						threads_t::iter_t it = que->begin();
-						if (!(*it)->timeslice())
-							it = timeslice_expired(*it, que);
-						return *it;
-					}
-				}
-			}
-		}
+					if ((_ready_bits[cpu][i] >> j) & 0x1)
+						return sizeof(bits_t)*8*i + j;
 		panic("no ready threads");
 		return 0;
 	}
 
-	// add ordered by timeout and prio
-	static threads_t::iter_t add_send(Thread_t* thr)
+	// get next Ready thread of current CPU
+	static Thread_t* get_highest_prio_ready_thread()
 	{
-		wassert(!is_exist(&_send_threads, thr));
-		_send_threads.push_back(thr);
-		return _send_threads.last();
+		unsigned cpu = Smp::cpu();
+		threads_t* que = ready_threads(cpu, highest_ready_prio(cpu));
+		wassert(que->size());
+		threads_t::iter_t it = que->begin();
+		if (!(*it)->timeslice())
+			it = timeslice_expired(*it, que);
+		return *it;
 	}
 
-	static threads_t::iter_t del_send(threads_t::iter_t it)
-	{
-		wassert(is_exist(&_send_threads, it));
-		_send_threads.erase(it);
-		return _send_threads.end();
-	}
 private:
 
-	// add ordered by timeout and prio
-	static threads_t::iter_t add_timeout_waiting(Thread_t* thr, threads_t* list)
-	{
-		wassert(!is_exist(list, thr));
-		for (threads_t::iter_t it=list->begin(); it!=list->end(); ++it)
-		{
-			if ((*it)->timeout() > thr->timeout()  ||
-				((*it)->timeout() == thr->timeout()  &&  (*it)->prio() < thr->prio()))
-			{
-				list->insert_before(it, thr);
-				return it-1;
-			}
-		}
-		list->push_back(thr);
-		return list->last();
-	}
-
-	static threads_t::iter_t del_timeout_waiting(threads_t::iter_t it, threads_t* list)
-	{
-		wassert(is_exist(list, it));
-		list->erase(it);
-		return list->end();
-	}
-
-	// return max prio thread with expired timeouts
-	static Thread_t* check_ipc_timeouts(L4_clock_t now, threads_t* list)
+	// return first thread with expired timeout, heap gives them by expire time and prio
+	static Thread_t* check_ipc_timeouts(L4_clock_t now, Timeouts_t* heap)
 	{
 		Thread_t* next = 0;
-		for (threads_t::iter_t it=list->begin(); it!=list->end(); )
+		while (Thread_t* t = heap->first())
 		{
-			Thread_t* t = *it;
 			wassert(t->state() == Thread_t::Send_ipc  ||  t->state() == Thread_t::Receive_ipc);
 
 			if (t->timeout() > now)
@@ -525,59 +524,82 @@ private:
 				next = t;
 
 			int phase = t->state() == Thread_t::Send_ipc ? L4_snd_phase : L4_rcv_phase;
+			Ktrace::log(L4_ktrace_ipc_tmout, t->globid().number(), phase);
 			L4_utcb_t* utcb = t->utcb();
 			utcb->ipc_error_code(L4_ipcerr_t(phase, L4_ipc_timeout));
 			L4_msgtag_t tag = utcb->msgtag();
 			tag.ipc_set_failed();
 			utcb->msgtag(tag);
 
-			threads_t::iter_t next_it = it + 1;
-			t->state(Thread_t::Ready);  // inside 'it' will be invalidate
-			it = next_it;
-
-			// remove inherited prio
-			if (!t->prio_heir().is_nil())
-			{
-				Thread_t* thr = threads_find(t->prio_heir());  // XXX optimize it
-				wassert(thr);
-				thr->inherit_prio_del(t->globid(), t->prio_max());
-				t->prio_heir(L4_thrid_t::Nil);
-			}
+			t->state(Thread_t::Ready);  // removes 't' from heap and returns inherited prio
 		}
 		return next;
 	}
 
 public:
 
-	static threads_t::iter_t add_rcv_timeout_waiting(Thread_t* thr)
+	static void add_rcv_timeout_waiting(Thread_t* thr)
 	{
 		wassert(thr->state() == Thread_t::Receive_ipc);
-		return add_timeout_waiting(thr, &_timeout_waiting_rcv_threads);
+		_timeout_waiting_rcv_threads[thr->cpu()].add(thr);
 	}
 
-	static threads_t::iter_t add_snd_timeout_waiting(Thread_t* thr)
+	static void add_snd_timeout_waiting(Thread_t* thr)
 	{
 		wassert(thr->state() == Thread_t::Send_ipc);
-		return add_timeout_waiting(thr, &_timeout_waiting_snd_threads);
+		_timeout_waiting_snd_threads[thr->cpu()].add(thr);
 	}
 
-	static threads_t::iter_t del_rcv_timeout_waiting(threads_t::iter_t it)
+	static void del_rcv_timeout_waiting(Thread_t* thr)
 	{
-		wassert((*it)->state() == Thread_t::Receive_ipc);
-		return del_timeout_waiting(it, &_timeout_waiting_rcv_threads);
+		wassert(thr->state() == Thread_t::Receive_ipc);
+		_timeout_waiting_rcv_threads[thr->cpu()].del(thr);
+	}
+
+	static void del_snd_timeout_waiting(Thread_t* thr)
+	{
+		wassert(thr->state() == Thread_t::Send_ipc);
+		_timeout_waiting_snd_threads[thr->cpu()].del(thr);
+	}
+
+	#if Cfg_krn_tickless
+	// nearest time when kernel needs timer irq:  end of timeslice, ipc timeout or irq hold
+	static L4_clock_t next_event(Thread_t* cur, L4_clock_t now)
+	{
+		L4_clock_t res = -1;
+
+		// timeslice matters only if there are other threads with the same prio
+		if (cur->state() == Thread_t::Ready  &&  ready_threads(cur->cpu(), cur->prio_max())->size() > 1)
+			res = now + cur->timeslice();
+
+		Thread_t* snd = _timeout_waiting_snd_threads[cur->cpu()].first();
+		Thread_t* rcv = _timeout_waiting_rcv_threads[cur->cpu()].first();
+		if (snd  &&  snd->timeout() < res)
+			res = snd->timeout();
+		if (rcv  &&  rcv->timeout() < res)
+			res = rcv->timeout();
+
+		// interrupts held by coalescing
+		for (unsigned i=0; i<Kcfg::Ints_max  &&  Int_thread_t::held(); ++i)
+			if (_int_threads[i].hold()  &&  _int_threads[i].hold() < res)
+				res = _int_threads[i].hold();
+		return res;
 	}
 
-	static threads_t::iter_t del_snd_timeout_waiting(threads_t::iter_t it)
+	// program timer for 'cur' thread, if !force - only if irq is needed earlier than programmed
+	static void tickless_update(Thread_t* cur, bool force)
 	{
-		wassert((*it)->state() == Thread_t::Send_ipc);
-		return del_timeout_waiting(it, &_timeout_waiting_snd_threads);
+		L4_clock_t next = next_event(cur, SystemClock_t::sys_clock(__func__));
+		if (force  ||  next < SystemClock_t::deadline())
+			SystemClock_t::reprogram(next);
 	}
+	#endif
 
-	// return max prio thread with expired timeouts
+	// return max prio thread with expired timeouts, every CPU checks timeouts of own threads
 	static Thread_t* check_ipc_timeouts(L4_clock_t now)
 	{
-		Thread_t* next1 = check_ipc_timeouts(now, &_timeout_waiting_snd_threads);
-		Thread_t* next2 = check_ipc_timeouts(now, &_timeout_waiting_rcv_threads);
+		Thread_t* next1 = check_ipc_timeouts(now, &_timeout_waiting_snd_threads[Smp::cpu()]);
+		Thread_t* next2 = check_ipc_timeouts(now, &_timeout_waiting_rcv_threads[Smp::cpu()]);
 		if (next1 && next2)
 			return next1->prio_max() > next2->prio_max() ? next1 : next2;
 		if (next1)
@@ -0,0 +1,135 @@
+//##################################################################################################
+//
+//  Timeouts - binary min-heap of threads waiting IPC with timeout.
+//
+//##################################################################################################
+
+#ifndef TIMEOUTS_H
+#define TIMEOUTS_H
+
+#include "kconfig.h"
+#include "thread.h"
+#include "wlibc_assert.h"
+
+// Heap is ordered by expire time, threads with equal expire time are ordered by prio,
+// the key is stored at insertion time like the previous sorted list did.
+// Thread keeps its heap position (timeout_idx) to allow delete without search.
+// Heap array is taken from Kmem and grows by doubling, it is sized by waiting threads only.
+class Timeouts_t
+{
+	enum { Cap_min = 16 };
+
+	struct Item_t
+	{
+		L4_clock_t timeout;
+		unsigned   prio;
+		Thread_t*  thr;
+	};
+
+	Item_t*  _heap;
+	unsigned _cap;
+	unsigned _sz;
+
+	static inline bool earlier(const Item_t& a, const Item_t& b)
+	{
+		return a.timeout < b.timeout  ||  (a.timeout == b.timeout  &&  a.prio > b.prio);
+	}
+
+	inline void place(unsigned i, const Item_t& item)
+	{
+		_heap[i] = item;
+		item.thr->timeout_idx(i);
+	}
+
+	void grow()
+	{
+		unsigned cap = _cap ? 2 * _cap : (unsigned)Cap_min;
+		Item_t* heap = (Item_t*) kmem_alloc(cap * sizeof(Item_t), sizeof(word_t));
+		for (unsigned i=0; i<_sz; ++i)
+			heap[i] = _heap[i];
+		if (_heap)
+			kmem_free(_heap);
+		_heap = heap;
+		_cap = cap;
+	}
+
+	void sift_up(unsigned i)
+	{
+		Item_t item = _heap[i];
+		while (i)
+		{
+			unsigned parent = (i - 1) / 2;
+			if (!earlier(item, _heap[parent]))
+				break;
+			place(i, _heap[parent]);
+			i = parent;
+		}
+		place(i, item);
+	}
+
+	void sift_down(unsigned i)
+	{
+		Item_t item = _heap[i];
+		while (1)
+		{
+			unsigned child = 2 * i + 1;
+			if (child >= _sz)
+				break;
+			if (child + 1 < _sz  &&  earlier(_heap[child + 1], _heap[child]))
+				child++;
+			if (!earlier(_heap[child], item))
+				break;
+			place(i, _heap[child]);
+			i = child;
+		}
+		place(i, item);
+	}
+
+public:
+
+	Timeouts_t() : _heap(0), _cap(0), _sz(0) {}
+
+	inline unsigned size()  const { return _sz;  }
+	inline bool     empty() const { return !_sz; }
+
+	// heap order, not sorted, used to iterate over all waiting threads
+	inline Thread_t* at(unsigned i) const
+	{
+		wassert(i < _sz);
+		return _heap[i].thr;
+	}
+
+	// thread with nearest expire time
+	inline Thread_t* first() const
+	{
+		return _sz ? _heap[0].thr : 0;
+	}
+
+	void add(Thread_t* thr)
+	{
+		wassert(_sz < Kcfg::Threads_max);
+		wassert(thr->timeout_idx() == Thread_t::No_timeout_idx);
+		if (_sz == _cap)
+			grow();
+		Item_t item = { thr->timeout(), thr->prio(), thr };
+		_heap[_sz] = item;
+		sift_up(_sz++);
+	}
+
+	void del(Thread_t* thr)
+	{
+		unsigned i = thr->timeout_idx();
+		wassert(i < _sz  &&  _heap[i].thr == thr);
+		thr->timeout_idx(Thread_t::No_timeout_idx);
+		if (i != --_sz)
+		{
+			// put last item to the hole and restore heap order in any direction
+			Thread_t* moved = _heap[_sz].thr;
+			place(i, _heap[_sz]);
+			sift_up(i);
+			sift_down(moved->timeout_idx());
+		}
+	}
+};
+
+#endif // TIMEOUTS_H
@@ -8,6 +8,16 @@
 #define TIME_ACCOUNT_H
 
 #include "wlibc_assert.h"
+#include "sys_proc.h"
+
+// Kernel spans are accounted in cycles too, usec clock is too coarse for them. Entry/exit ASM
+// code stores low word of cycle counter to cur_kentry_start/cur_kexit_end, sparc stores raw timer
+// value there because it has no cycle counter, SMP kernel has no per-CPU slots for them.
+#if !defined(Cfg_arch_sparc)  &&  !Cfg_krn_smp
+#  define TMACCOUNT_ASM_CYCLES 1
+#else
+#  define TMACCOUNT_ASM_CYCLES 0
+#endif
 
 class Time_account_t
 {
@@ -49,15 +59,18 @@ class Time_account_t
 	L4_clock_t  points[Tp_max];     // profiler points
 	L4_clock_t  spans[Ts_max];      // profiler timespans
 	unsigned    prev_point;         //
+	uint32_t    cyc_points[Tp_max]; // low word of cycle counter, enough for kernel spans
+	uint64_t    cyc_spans[Ts_max];  // kernel timespans in cycles, execution span isn't used
+	unsigned    kentries;           // kernel entries number to get average cost
 
 public:
 
-	Time_account_t(const char* n) : thr_name(n), prev_point(Tp_suspend)
+	Time_account_t(const char* n) : thr_name(n), prev_point(Tp_suspend), kentries(0)
 	{
 		for (int i=0; i<Tp_max; ++i)
-			points[i] = 0;
+			points[i] = cyc_points[i] = 0;
 		for (int i=0; i<Ts_max; ++i)
-			spans[i] = 0;
+			spans[i] = cyc_spans[i] = 0;
 	}
 
 	L4_clock_t tmspan_exec()     const { return spans[Ts_execution]; }
@@ -70,6 +83,13 @@ public:
 	L4_clock_t tmspan_kwork2()   const { return spans[Ts_kwork_2]; }
 	L4_clock_t tmspan_kwork3()   const { return spans[Ts_kwork_3]; }
 	L4_clock_t tmpoint_suspend() const { return points[Tp_suspend]; }
+	uint64_t   cycspan_kentry()  const { return cyc_spans[Ts_kentry]; }
+	uint64_t   cycspan_kwork()   const { return cyc_spans[Ts_kwork]; }
+	uint64_t   cycspan_kexit()   const { return cyc_spans[Ts_kexit]; }
+	uint64_t   cycspan_kwork1()  const { return cyc_spans[Ts_kwork_1]; }
+	uint64_t   cycspan_kwork2()  const { return cyc_spans[Ts_kwork_2]; }
+	uint64_t   cycspan_kwork3()  const { return cyc_spans[Ts_kwork_3]; }
+	unsigned   kentries_num()    const { return kentries; }
 
 	void tmevent_tick(L4_clock_t now)
 	{
@@ -97,6 +117,7 @@ public:
 		wassert(prev_point == Tp_suspend);
 		prev_point = Tp_resume;
 		points[prev_point] = now;
+		cyc_points[prev_point] = Proc::cycles();
 	}
 
 	// point #2 - update whole-execution and kernel-work timespans
@@ -104,10 +125,13 @@ public:
 	{
 		//printf("%s:  %s:  prev_point=%d/%s.\n", __func__, thr_name, prev_point, name(prev_point));
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume  ||  prev_point == Tp_kexit_start);
+		uint32_t cyc = Proc::cycles();
 		spans[Ts_execution] += now - points[prev_point];
 		spans[Ts_kwork]     += now - points[prev_point];
+		cyc_spans[Ts_kwork] += (uint32_t)(cyc - cyc_points[prev_point]);
 		prev_point = Tp_kexit_start;
 		points[prev_point] = now;
+		cyc_points[prev_point] = cyc;
 	}
 
 	// point #3 - update whole-execution and account ASM-code timespans
@@ -115,11 +139,32 @@ public:
 	{
 		//printf("%s:  %s:  prev_point=%d/%s.\n", __func__, thr_name, prev_point, name(prev_point));
 		wassert(prev_point == Tp_kexit_start  ||  prev_point == Tp_resume  ||  prev_point == Tp_kentry_end);
+		uint32_t cyc = Proc::cycles();
+		kentries++;
+
+		#if TMACCOUNT_ASM_CYCLES
+
+		// kexit stamp belongs to this thread if it left kernel via kexit_start,
+		// entry stamp is always fresh:  it is taken by ASM code of this entry
+		extern int cur_kentry_start;
+		extern int cur_kexit_end;
+		if (prev_point == Tp_kexit_start)
+			cyc_spans[Ts_kexit] += (uint32_t)(cur_kexit_end - cyc_points[Tp_kexit_start]);
+		cyc_spans[Ts_kentry] += (uint32_t)(cyc - cur_kentry_start);
+
+		#endif // TMACCOUNT_ASM_CYCLES
 
 		// account whole execution timespan
 		spans[Ts_execution] += now - points[prev_point];
 		prev_point = Tp_kentry_end;
 		points[prev_point] = now;
+		cyc_points[prev_point] = cyc;
+
+		#if defined(Cfg_arch_sparc)
+
+		// ASM points are raw timer values inside tick-aligned period,
+		// in tickless mode period is not aligned, so don't account kentry/kexit timespans
+		#if !Cfg_krn_tickless
 
 		// account kexit timespan
 		// NOTE 1:  first kentry doesn't have point Tp_kexit_start
@@ -149,6 +194,9 @@ public:
 			points[Tp_kentry_start] = start;
 			spans[Ts_kentry] += points[Tp_kentry_end] - points[Tp_kentry_start];
 		}
+
+		#endif // !Cfg_krn_tickless
+		#endif // Cfg_arch_sparc
 	}
 
 	// point #4 - end of accounting period, update whole-execution and kernel-work timespans
@@ -156,10 +204,13 @@ public:
 	{
 		//printf("%s:  %s:  prev_point=%d/%s.\n", __func__, thr_name, prev_point, name(prev_point));
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume);
+		uint32_t cyc = Proc::cycles();
 		spans[Ts_execution] += now - points[prev_point];
 		spans[Ts_kwork]     += now - points[prev_point];
+		cyc_spans[Ts_kwork] += (uint32_t)(cyc - cyc_points[prev_point]);
 		prev_point = Tp_suspend;
 		points[prev_point] = now;
+		cyc_points[prev_point] = cyc;
 	}
 
 	// start of profiler span 1
@@ -167,6 +218,7 @@ public:
 	{
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume);
 		points[Tp_kwork_1s] = now;
+		cyc_points[Tp_kwork_1s] = Proc::cycles();
 	}
 
 	// end of profiler span 1
@@ -174,6 +226,7 @@ public:
 	{
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume);
 		spans[Ts_kwork_1] += now - points[Tp_kwork_1s];
+		cyc_spans[Ts_kwork_1] += (uint32_t)(Proc::cycles() - cyc_points[Tp_kwork_1s]);
 	}
 
 	// start of profiler span 2
@@ -181,6 +234,7 @@ public:
 	{
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume);
 		points[Tp_kwork_2s] = now;
+		cyc_points[Tp_kwork_2s] = Proc::cycles();
 	}
 
 	// end of profiler span 2
@@ -188,6 +242,7 @@ public:
 	{
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume);
 		spans[Ts_kwork_2] += now - points[Tp_kwork_2s];
+		cyc_spans[Ts_kwork_2] += (uint32_t)(Proc::cycles() - cyc_points[Tp_kwork_2s]);
 	}
 
 	// start of profiler span 3
@@ -195,6 +250,7 @@ public:
 	{
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume);
 		points[Tp_kwork_3s] = now;
+		cyc_points[Tp_kwork_3s] = Proc::cycles();
 	}
 
 	// end of profiler span 3
@@ -202,6 +258,7 @@ public:
 	{
 		wassert(prev_point == Tp_kentry_end  ||  prev_point == Tp_resume);
 		spans[Ts_kwork_3] += now - points[Tp_kwork_3s];
+		cyc_spans[Ts_kwork_3] += (uint32_t)(Proc::cycles() - cyc_points[Tp_kwork_3s]);
 	}
 };
 
@@ -11,6 +11,8 @@
 #include "printk.h"
 #include "wlibc_panic.h"
 #include "arch_data.h"
+#include "sys_proc.h"
+#include "kkip.h"
 #include <string.h>
 
 //--------------------------------------------------------------------------------------------------
@@ -79,6 +81,11 @@ struct Hw_tss_t
 	}
 } __attribute__((packed));
 #else // Cfg_arch_x86_64
+
+// NMI and #MC come via ist1:  syscall entry and sysret exit run in ring 0 on user rsp for a
+// few instructions, the stack from tss is not used for exceptions in ring 0
+static uint8_t ist1_stack[Cfg_page_sz] __attribute__((aligned(16)));
+
 struct Hw_tss_t
 {
 	uint32_t	reserved1;
@@ -98,6 +105,8 @@ struct Hw_tss_t
 
 	inline void init()
 	{
+		ist[0] = (long)ist1_stack + sizeof(ist1_stack);
+
 		// Load the index of our TSS structure - The index is
 		// 0x28, as it is the 5th selector and each is 8 bytes
 		// long, but we set the bottom two bits (making 0x2b)
@@ -243,7 +252,7 @@ struct Gdtr_t
 
 static_assert(sizeof(Gdtr_t) == sizeof(word_t) + 2);
 
-Glob_desc_t gdt[8] __attribute__((aligned(8)));
+Glob_desc_t gdt[10] __attribute__((aligned(8)));
 
 Tss_t tss;
 
@@ -322,6 +331,10 @@ void set_gdt()
 
 		// 0x38:  selector to access at 0xff000000 as gs:0, need to get UTCB address
 		gdt[7].set(0xff000000, sizeof(long), Limit_bytes, Type_data, Priv_user, Opsz_64bit);
+
+		// 0x40, 0x48:  copies of user data and code, sysret takes them as STAR base + 8/16
+		gdt[8].set(0x0, 0x0, Limit_bytes, Type_data, Priv_user, Opsz_64bit);
+		gdt[9].set(0x0, 0x0, Limit_bytes, Type_code, Priv_user, Opsz_64bit);
 	}
 	else
 		panic("unknown bitness\n\r");
@@ -338,6 +351,61 @@ void set_gdt()
 	printk("Hello new GDT.\n");
 }
 
+//--------------------------------------------------------------------------------------------------
+//  Fast syscall entry
+//--------------------------------------------------------------------------------------------------
+
+#ifdef Cfg_arch_x86
+
+enum
+{
+	Msr_sysenter_cs  = 0x174,
+	Msr_sysenter_esp = 0x175,
+	Msr_sysenter_eip = 0x176
+};
+
+// entry stub switches to tss.esp0 at once, this stack is used only if NMI comes before it
+static uint8_t sysenter_stack[0x100] __attribute__((aligned(16)));
+
+// sysenter loads cs/ss 0x08/0x10, sysexit loads 0x1b/0x23, the GDT is already laid out so
+void set_fast_scall()
+{
+	extern int x86_sysenter_entry;
+	Proc::msr(Msr_sysenter_cs, 0x08);
+	Proc::msr(Msr_sysenter_esp, (long)sysenter_stack + sizeof(sysenter_stack));
+	Proc::msr(Msr_sysenter_eip, (long)&x86_sysenter_entry);
+	get_kip()->fast_scall = 1;
+	printk("Fast syscall entry:  sysenter.\n");
+}
+
+#else // 64
+
+enum
+{
+	Msr_efer  = 0xc0000080,
+	Msr_star  = 0xc0000081,
+	Msr_lstar = 0xc0000082,
+	Msr_fmask = 0xc0000084,
+
+	Efer_sce  = 1 << 0,
+	Star_syscall_cs = 0x08,   // syscall loads cs/ss 0x08/0x10
+	Star_sysret_cs  = 0x38,   // sysret loads ss/cs 0x43/0x4b, see gdt[8], gdt[9]
+	Fmask = 0x40700           // clear AC, DF, IF, TF on entry
+};
+
+void set_fast_scall()
+{
+	extern int x86_syscall_entry;
+	Proc::msr(Msr_star, ((uint64_t)Star_sysret_cs << 48) | ((uint64_t)Star_syscall_cs << 32));
+	Proc::msr(Msr_lstar, (long)&x86_syscall_entry);
+	Proc::msr(Msr_fmask, Fmask);
+	Proc::msr(Msr_efer, Proc::msr(Msr_efer) | Efer_sce);
+	get_kip()->fast_scall = 1;
+	printk("Fast syscall entry:  syscall.\n");
+}
+
+#endif
+
 //--------------------------------------------------------------------------------------------------
 //  IDT
 //--------------------------------------------------------------------------------------------------
@@ -449,6 +517,11 @@ void set_idt()
 		idt[i].set(gate_table_arr[i], i==0x80 ? Priv_user : Priv_kernel); // allow user to use sw irq 0x80
 	}
 
+	#ifdef Cfg_arch_x86_64
+	idt[2].ist  = 1;  // NMI
+	idt[18].ist = 1;  // machine check
+	#endif
+
 	Idtr_t idtr;
 	idtr.limit = sizeof(idt) - 1;
 	idtr.base  = (long) idt;
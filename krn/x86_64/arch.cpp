@@ -14,6 +14,14 @@ void arch_init()
 	set_gdt();
 	set_idt();
 	tss.init();
+	#if Cfg_krn_fastscall
+	set_fast_scall();
+	#endif
+}
+
+void arch_init_cpu()
+{
+	// nothing, SMP kernel is supported for arm only
 }
 
 void arch_set_timer_va(long va)
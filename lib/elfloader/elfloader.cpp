@@ -155,6 +155,9 @@ enum
 	Pflags_x             = 0x1,
 	Pflags_w             = 0x2,
 	Pflags_r             = 0x4,
+
+	// symbol type, low 4 bits of symbol info
+	Symtype_func         = 0x2,
 };
 
 #ifdef DEBUG
@@ -379,6 +382,26 @@ struct Elf_phdr64_t
 	uint64_t align;   // segment alignment, file & memory
 };
 
+struct Elf_sym32_t
+{
+	uint32_t name;
+	uint32_t value;
+	uint32_t size;
+	uint8_t  info;
+	uint8_t  other;
+	uint16_t shndx;
+};
+
+struct Elf_sym64_t
+{
+	uint32_t name;    // symbol name, index in string tbl
+	uint8_t  info;    // symbol type and binding
+	uint8_t  other;   // symbol visibility
+	uint16_t shndx;   // section index
+	uint64_t value;   // symbol value
+	uint64_t size;    // symbol size
+};
+
 template <typename HDR_t>
 static void to_host_hdr(HDR_t* in, HDR_t* out, int endian)
 {
@@ -807,3 +830,81 @@ extern "C" int elf_foreach(const void* elf, size_t sz, Elf_shdr_func_t sh_func,
 	return 0;
 }
 
+
+template <typename HDR_t, typename SHDR_t, typename SYM_t>
+static int symbol(const void* elf, size_t sz, addr_t addr, const char** name, size_t* offset,
+                  int endian, Elf_dprint_t dprint)
+{
+	// convert to host endianness
+	HDR_t* eh = (HDR_t*) elf;
+	HDR_t ehdr;
+	to_host_hdr(eh, &ehdr, endian);
+
+	const char* best_name = 0;
+	addr_t best_addr = 0;
+
+	for (unsigned i=0; i<ehdr.shnum; ++i)
+	{
+		SHDR_t* sh = (SHDR_t*)((size_t)elf + ehdr.shoff + i * ehdr.shentsize);
+		SHDR_t shdr;
+		to_host_shdr(sh, &shdr, endian);
+
+		if (shdr.type != Stype_symtab  ||  shdr.link >= ehdr.shnum  ||  shdr.offset + shdr.size > sz)
+			continue;
+
+		SHDR_t* sh_str = (SHDR_t*)((size_t)elf + ehdr.shoff + shdr.link * ehdr.shentsize);
+		const char* str_tb = (char*)((size_t)elf + to_host(sh_str->offset, endian));
+
+		unsigned num = shdr.size / sizeof(SYM_t);
+		for (unsigned j=0; j<num; ++j)
+		{
+			SYM_t* sym = (SYM_t*)((size_t)elf + shdr.offset + j * sizeof(SYM_t));
+			if ((sym->info & 0xf) != Symtype_func)
+				continue;
+
+			addr_t value = to_host(sym->value, endian);
+			addr_t size = to_host(sym->size, endian);
+			if (addr < value  ||  value < best_addr)
+				continue;
+
+			// prefer symbol that contains address, else take nearest below
+			if (addr < value + size  ||  !size  ||  !best_name)
+			{
+				best_name = str_tb + to_host(sym->name, endian);
+				best_addr = value;
+			}
+		}
+	}
+
+	if (!best_name)
+	{
+		print("symbol:  no function for addr=0x%lx.\n", addr);
+		return 1;
+	}
+
+	*name = best_name;
+	if (offset)
+		*offset = addr - best_addr;
+	return 0;
+}
+
+extern "C" int elf_symbol(const void* elf, size_t sz, addr_t addr, const char** name, size_t* offset,
+                          Elf_dprint_t dprint)
+{
+	*name = 0;
+
+	int rc = elf_check(elf, sz, dprint);
+	if (rc)
+	{
+		print("symbol:  ERROR:  elf is not valid, rc=%d.\n", rc);
+		return 100 + rc;
+	}
+
+	Elf_ident_t* ident = (Elf_ident_t*) elf;
+	int endian = ident->endian == Endian_big ? Big_endian : Little_endian;
+
+	if (ident->format == Fmt_32bit)
+		return symbol<Elf_hdr32_t, Elf_shdr32_t, Elf_sym32_t>(elf, sz, addr, name, offset, endian, dprint);
+	else // 64-bit
+		return symbol<Elf_hdr64_t, Elf_shdr64_t, Elf_sym64_t>(elf, sz, addr, name, offset, endian, dprint);
+}
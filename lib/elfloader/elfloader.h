@@ -44,6 +44,13 @@ typedef void (*Elf_phdr_func_t)(size_t label, addr_t vaddr, addr_t paddr, size_t
 int elf_foreach(const void* elf, size_t sz, Elf_shdr_func_t sh_func,
                 Elf_phdr_func_t ph_func, size_t label, addr_t* entry, Elf_dprint_t dprint = Elf_no_dprint);
 
+// find function symbol from .symtab that contains addr or nearest below it
+// out:     name   - symbol name inside elf
+//          offset - addr offset from symbol start
+// return:  0 if success or error code
+int elf_symbol(const void* elf, size_t sz, addr_t addr, const char** name, size_t* offset,
+               Elf_dprint_t dprint = Elf_no_dprint);
+
 
 #ifdef __cplusplus
 }
@@ -133,6 +133,36 @@ inline void intc_init(unsigned long base_addr, Intc_print_t dprint)
 
 }
 
+// init CPU interface of current CPU, distributor is inited by intc_init()
+inline void intc_init_cpu(unsigned long base_addr)
+{
+	volatile Intc_regs_t* regs = (Intc_regs_t*) base_addr;
+	regs->gicc.control = 0;          // disable cpu iface
+	regs->gicc.prio_mask = 0xff;     // set lowest prio, allow all irq prios
+	regs->gicc.bin_point = 0x7;      // ?
+	regs->gicd.set_en[0] = 0xffff;   // enable SGIs, banked register
+	regs->gicc.control = 1;          // enable cpu iface
+}
+
+// send software generated interrupt (0-15) to CPUs from mask
+inline int intc_send_sgi(unsigned long base_addr, unsigned irq, unsigned cpu_mask)
+{
+	volatile Intc_regs_t* regs = (Intc_regs_t*) base_addr;
+
+	if (irq >= 16)
+		return 1;
+
+	regs->gicd.sgi = ((cpu_mask & 0xff) << 16) | irq;  // target list filter = 0, use cpu list
+	return 0;
+}
+
+// end of interrupt by raw ICCIAR value, SGI needs source CPU id
+inline void intc_eoi_ack(unsigned long base_addr, unsigned ack)
+{
+	volatile Intc_regs_t* regs = (Intc_regs_t*) base_addr;
+	regs->gicc.eoi = ack;
+}
+
 inline int intc_unmask(unsigned long base_addr, unsigned irq)
 {
 	volatile Intc_regs_t* regs = (Intc_regs_t*) base_addr;
@@ -11,6 +11,7 @@
 #include "l4_types.h"
 #include "l4_ipcerr.h"
 #include "l4_kdbops.h"
+#include "l4_ktrace.h"
 #include "l4_syscalls.h"
 
 // TODO
@@ -20,7 +21,9 @@
 
 L4_kip_t*  l4_kip();                  // get pointer to KIP
 L4_utcb_t* l4_utcb();                 // get pointer to UTCB
+int        l4_fast_syscall(int enable);  // wrm extention:  sysenter/syscall entry for x86, returns previous
 int        l4_ipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid_t* from=0);
+int        l4_lipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid_t* from=0);
 int        l4_send(L4_thrid_t to, L4_time_t timeout);
 int        l4_receive(L4_thrid_t from_spec, L4_time_t timeout, L4_thrid_t* from=0);
 void       l4_unmap(word_t control); // fpages in MRs
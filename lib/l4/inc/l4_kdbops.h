@@ -8,12 +8,32 @@
 #define L4_KDBOPS_H
 
 #include <stdint.h>
+#include "sys_types.h"
 
 enum L4_kdb_ops_t
 {
 	L4_kdb_print   = 1,  // print via kernel uart
 	L4_kdb_console = 2,  // enter to kdb console
-	L4_kdb_threads = 3   // get threads info
+	L4_kdb_threads = 3,  // get threads info
+	L4_kdb_ktrace  = 4,  // set trace class mask, map trace rings if data!=0, see l4_ktrace.h
+	L4_kdb_kprof   = 5,  // sampling profiler, param - L4_kprof_ops_t
+	L4_kdb_ipcstat = 6   // IPC histograms, param - L4_ipcstat_ops_t
+};
+
+enum L4_kprof_ops_t
+{
+	L4_kprof_start = 1,  // drop old samples and start sampling on timer ticks
+	L4_kprof_stop  = 2,  //
+	L4_kprof_read  = 3   // copy samples to buffer, return number of copied samples
+};
+
+enum L4_ipcstat_ops_t
+{
+	L4_ipcstat_start  = 1,  // drop old histograms and start collecting
+	L4_ipcstat_stop   = 2,  //
+	L4_ipcstat_info   = 3,  // copy L4_ipcstat_info_t to buffer
+	L4_ipcstat_pairs  = 4,  // copy task pairs to buffer, return number of copied pairs
+	L4_ipcstat_thread = 5   // fill blocked histogram of L4_ipcstat_thread_t, thrid is set by caller
 };
 
 // FIXME:  replace me, think!
@@ -25,7 +45,52 @@ struct L4_kdb_thread_info_t
 	uint64_t thr_uptime_usec;
 	uint64_t sys_uptime_usec;
 	uint64_t no_activity_usec;
+	unsigned kstack_sz;    // kernel stack size
+	unsigned kstack_used;  // max used bytes of kernel stack
 };
 
+// sample of interrupted code, kernel samples are taken in idle loop
+struct L4_kprof_sample_t
+{
+	enum { Kernel = 1 };
+
+	word_t   pc;       // user pc, 0 for kernel
+	uint16_t thrid;    // thread number
+	uint8_t  cpu;      //
+	uint8_t  flags;    // Kernel
+};
+
+// log2 histogram:  cnt[0] counts spans 0..1, cnt[N] counts spans 2^N..2^(N+1)-1, the last
+// bucket counts longer spans too
+enum { L4_ipcstat_buckets = 32 };
+struct L4_ipcstat_hist_t
+{
+	uint32_t cnt[L4_ipcstat_buckets];
+};
+
+struct L4_ipcstat_info_t
+{
+	uint32_t on;       //
+	uint32_t usec;     // spans are in usec, otherwise in cycles
+	uint32_t pairs;    // used pairs
+	uint32_t lost;     // samples of pairs that don't fit to kernel table
+};
+
+// (sender task, receiver task) pair, tasks are named by thread numbers of the first sample
+struct L4_ipcstat_pair_t
+{
+	uint16_t snd_thr;            //
+	uint16_t rcv_thr;            //
+	uint32_t reserved;           //
+	L4_ipcstat_hist_t latency;   // from sender syscall entry to receiver syscall exit
+	L4_ipcstat_hist_t rtt;       // call round trip, sender is caller
+};
+
+struct L4_ipcstat_thread_t
+{
+	uint32_t thrid;              // thread number
+	uint32_t reserved;           //
+	L4_ipcstat_hist_t blocked;   // time in send and receive phases of IPC
+};
 
 #endif // L4_KDBOPS_H
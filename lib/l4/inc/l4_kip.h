@@ -103,6 +103,19 @@ typedef struct
 
 static_assert(sizeof(Mem_desc_t) == 2*sizeof(word_t));
 
+// wrm extention:  clock data, kernel updates it on timer tick under seqlock,
+// user gets clock without syscall:  base_usec + ((cycles - base_cycles) * usec_mult >> 32)
+typedef struct
+{
+	word_t   seq;          // odd while kernel updates data
+	word_t   reserved;     //
+	uint64_t base_usec;    // system clock at base_cycles
+	uint64_t base_cycles;  // cycle counter at last update
+	uint64_t usec_mult;    // usec per cycle, fixed point 32.32, 0 - not calibrated, use syscall
+} L4_kip_clock_t;
+
+static_assert(sizeof(L4_kip_clock_t) % sizeof(word_t) == 0);
+
 // according to l4-x2-r6.pdf (sections 1.1 and 7.7)
 typedef struct
 {
@@ -140,7 +153,12 @@ typedef struct
 	word_t kdebug_config0;         //
 	word_t kdebug_config1;         //
 
+	#if 1 // wrm extention
+	L4_kip_clock_t clock;          // 0x60 / 0xc0
+	word_t padding_2 [16 - sizeof(L4_kip_clock_t)/sizeof(word_t)];
+	#else // original L4
 	word_t padding_2 [16];         // 0x60 / 0xc0
+	#endif
 
 	#if 1 // wrm extention
 	word_t uptime_usec_hi;         //
@@ -173,7 +191,11 @@ typedef struct
 	word_t system_clock_sc;        // 0xf0 / 0x1e0  // normal syscall
 	word_t thread_switch_sc;       //               // normal syscall
 	word_t schedule_sc;            //               // normal syscall
+	#if 1 // wrm extention
+	word_t fast_scall;             //               // 1 - sysenter/syscall entry is set up (x86)
+	#else
 	word_t padding_5 [1];          //
+	#endif
 } L4_kip_t;
 
 static_assert(sizeof(L4_kip_t) == 64*sizeof(word_t));
@@ -203,4 +225,23 @@ inline uint64_t l4_kip_get_uptime_usec(L4_kip_t* kip)
 	}
 }
 
+// read clock data of kip, 'cycles' reads cycle counter of the processor,
+// return 0 if clock is not calibrated
+inline uint64_t l4_kip_get_clock_usec(const L4_kip_t* kip, uint64_t (*cycles)())
+{
+	const volatile L4_kip_clock_t* clk = &kip->clock;
+	while (1)
+	{
+		word_t seq = clk->seq;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;  // kernel is updating
+		uint64_t mult = clk->usec_mult;
+		uint64_t res = mult  ?  clk->base_usec + (((cycles() - clk->base_cycles) * mult) >> 32)  :  0;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (clk->seq == seq)
+			return res;
+	}
+}
+
 #endif // L4_KIP_H
@@ -0,0 +1,61 @@
+//##################################################################################################
+//
+//  Kernel trace records, wrm extention.
+//
+//  Kernel appends fixed size binary records of enabled event classes to per-CPU ring. Rings of
+//  all CPUs may be mapped read-only to privileged task by l4_kdb(L4_kdb_ktrace, ...).
+//
+//  Ring is header followed by 'size' records, record with number N is rec[N % size]. Kernel
+//  writes record and then increments wp, so reader takes wp, copies records and takes wp
+//  again:  records with numbers below wp2 - size were overwritten during copying.
+//
+//##################################################################################################
+
+#ifndef L4_KTRACE_H
+#define L4_KTRACE_H
+
+#include "sys_types.h"
+
+// event classes, bit per class in enable mask
+enum L4_ktrace_class_t
+{
+	L4_ktrace_ipc     = 0,  // ipc and lipc syscalls
+	L4_ktrace_sched   = 1,  // context switch
+	L4_ktrace_pfault  = 2,  // user page fault
+	L4_ktrace_irq     = 3,  // kernel entry by hw irq
+	L4_ktrace_timeout = 4   // ipc timeout expiry
+};
+
+// event = class << 8 | number in class
+enum L4_ktrace_event_t
+{
+	L4_ktrace_ipc_send  = 0x001,  // syscall entry:    arg0 - to,     arg1 - msgtag
+	L4_ktrace_ipc_recv  = 0x002,  // syscall exit:     arg0 - from,   arg1 - msgtag
+	L4_ktrace_switch    = 0x101,  //                   arg0 - next thread number, arg1 - next prio
+	L4_ktrace_pf        = 0x201,  //                   arg0 - fault address, arg1 - fault inst
+	L4_ktrace_irq_entry = 0x301,  //                   arg0 - irq
+	L4_ktrace_irq_exit  = 0x302,  //                   arg0 - irq
+	L4_ktrace_ipc_tmout = 0x401   // thrid - expired:  arg0 - ipc phase
+};
+
+static inline unsigned l4_ktrace_class(unsigned event) { return event >> 8; }
+
+struct L4_ktrace_rec_t
+{
+	uint64_t time;     // cycles
+	uint32_t thrid;    // number of current thread
+	uint16_t event;    // L4_ktrace_event_t
+	uint16_t cpu;      //
+	uint64_t arg[2];   //
+};
+
+struct L4_ktrace_hdr_t
+{
+	word_t   wp;       // records written since boot
+	word_t   size;     // records in ring
+	uint64_t reserved[(32 - 2*sizeof(word_t)) / sizeof(uint64_t)];
+};
+
+static_assert(sizeof(L4_ktrace_rec_t) == 32  &&  sizeof(L4_ktrace_hdr_t) == 32, "ktrace:  wrong layout");
+
+#endif // L4_KTRACE_H
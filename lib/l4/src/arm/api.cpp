@@ -46,10 +46,21 @@ L4_kip_t* l4_kip()
 	return app_data.kip;
 }
 
+// only one syscall entry for this arch
+int l4_fast_syscall(int enable)
+{
+	(void)enable;
+	return 0;
+}
+
 // get pointer to UTCB
 L4_utcb_t* l4_utcb()
 {
-	return *(L4_utcb_t**)0xff000000;    // UTCB address can be loaded from 0xff000000
+	// kernel sets TPIDRURO on every switch, it is per CPU unlike word at 0xff000000,
+	// so user libs don't depend on kernel SMP config
+	L4_utcb_t* utcb;
+	asm volatile ("mrc  p15, 0, %0, c13, c0, 3" : "=r"(utcb));  // TPIDRURO
+	return utcb;
 }
 
 // get my local ID, equal to UTCB address
@@ -77,6 +88,21 @@ int l4_ipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid
 	return l4_utcb()->msgtag().ipc_is_failed() ? l4_utcb()->ipc_error_code().error() : 0;
 }
 
+// do Lipc syscall, partners are in the same task
+int l4_lipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid_t* from)
+{
+	register L4_thrid_t    r0 asm ("r0") = to;
+	register L4_thrid_t    r1 asm ("r1") = from_spec;
+	register L4_timeouts_t r2 asm ("r2") = timeouts;
+	register word_t        r7 asm ("r7") = L4_syscall_lipc;
+	(void)r0; (void)r1; (void)r2; (void)r7;
+	do_syscall();
+	register word_t rcv_from asm ("r0");
+	if (from)
+		*from = rcv_from;
+	return l4_utcb()->msgtag().ipc_is_failed() ? l4_utcb()->ipc_error_code().error() : 0;
+}
+
 // send phase only
 int l4_send(L4_thrid_t to, L4_time_t timeout)
 {
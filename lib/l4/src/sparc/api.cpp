@@ -42,6 +42,13 @@ L4_kip_t* l4_kip()
 	return app_data.kip;
 }
 
+// only one syscall entry for this arch
+int l4_fast_syscall(int enable)
+{
+	(void)enable;
+	return 0;
+}
+
 // get pointer to UTCB
 L4_utcb_t* l4_utcb()
 {
@@ -78,6 +85,21 @@ int l4_ipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid
 	return l4_utcb()->msgtag().ipc_is_failed() ? l4_utcb()->ipc_error_code().error() : 0;
 }
 
+// do Lipc syscall, partners are in the same task
+int l4_lipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid_t* from)
+{
+	register word_t        g1 asm ("%g1") = L4_syscall_lipc;
+	register L4_thrid_t    o0 asm ("%o0") = to;
+	register L4_thrid_t    o1 asm ("%o1") = from_spec;
+	register L4_timeouts_t o2 asm ("%o2") = timeouts;
+	(void)g1; (void)o0; (void)o1; (void)o2;
+	do_syscall();
+	register word_t rcv_from asm ("%o0");
+	if (from)
+		*from = rcv_from;
+	return l4_utcb()->msgtag().ipc_is_failed() ? l4_utcb()->ipc_error_code().error() : 0;
+}
+
 // send phase only
 int l4_send(L4_thrid_t to, L4_time_t timeout)
 {
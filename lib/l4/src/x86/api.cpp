@@ -7,10 +7,12 @@
 #include "l4_api.h"
 #include "l4_syscalls.h"
 #include "sys_utils.h"
+#include "sys_proc.h"
 
 struct App_data_t
 {
-	L4_kip_t* kip;  // also it is used as init flag
+	L4_kip_t* kip;         // also it is used as init flag
+	uint8_t   fast_scall;  // use sysenter instead of int 0x80
 };
 
 static App_data_t app_data;
@@ -20,6 +22,37 @@ __attribute__((always_inline)) inline void do_syscall()
 	asm volatile ("int $0x80");
 }
 
+// sysexit takes esp/eip from ecx/edx:  pass syscall number in esi, return eip in edi, esp in ebp,
+// keep ecx/edx on own stack; only for syscalls with args and results in eax, ebx, ecx, edx
+__attribute__((always_inline)) inline void do_fast_syscall()
+{
+	asm volatile
+	(
+		"cmpb $0, %0          \n"
+		"je 1f                \n"
+		"push %%ebp           \n"
+		"push %%esi           \n"
+		"push %%edi           \n"
+		"push %%ecx           \n"
+		"push %%edx           \n"
+		"mov 20(%%esp), %%esi \n"  // syscall number pushed by caller
+		"mov $2f, %%edi       \n"
+		"mov %%esp, %%ebp     \n"
+		"sysenter             \n"
+		"2:                   \n"
+		"pop %%edx            \n"
+		"pop %%ecx            \n"
+		"pop %%edi            \n"
+		"pop %%esi            \n"
+		"pop %%ebp            \n"
+		"jmp 3f               \n"
+		"1:                   \n"
+		"int $0x80            \n"
+		"3:                   \n"
+		:: "m"(app_data.fast_scall) : "memory", "cc"
+	);
+}
+
 // get pointer to Kernel Interface Page
 L4_kip_t* l4_kip()
 {
@@ -43,9 +76,18 @@ L4_kip_t* l4_kip()
 	do_syscall();
 	asm volatile ("add $4, %esp"); // leave syscall number
 	app_data.kip = (L4_kip_t*) eax;
+	app_data.fast_scall = app_data.kip->fast_scall;
 	return app_data.kip;
 }
 
+// select syscall entry, fast one is used by default if kernel supports it
+int l4_fast_syscall(int enable)
+{
+	int prev = app_data.fast_scall;
+	app_data.fast_scall = enable  &&  l4_kip()->fast_scall;
+	return prev;
+}
+
 // get pointer to UTCB
 L4_utcb_t* l4_utcb()
 {
@@ -68,7 +110,23 @@ int l4_ipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid
 	register L4_timeouts_t ecx asm ("ecx") = timeouts;
 	(void)eax; (void)edx; (void)ecx;
 	asm volatile ("pushl %0" :: "n"(L4_syscall_ipc));
-	do_syscall();
+	do_fast_syscall();
+	asm volatile ("add $4, %esp"); // leave syscall number
+	register word_t rcv_from asm ("eax");
+	if (from)
+		*from = rcv_from;
+	return l4_utcb()->msgtag().ipc_is_failed() ? l4_utcb()->ipc_error_code().error() : 0;
+}
+
+// do Lipc syscall, partners are in the same task
+int l4_lipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid_t* from)
+{
+	register L4_thrid_t    eax asm ("eax") = to;
+	register L4_thrid_t    edx asm ("edx") = from_spec;
+	register L4_timeouts_t ecx asm ("ecx") = timeouts;
+	(void)eax; (void)edx; (void)ecx;
+	asm volatile ("pushl %0" :: "n"(L4_syscall_lipc));
+	do_fast_syscall();
 	asm volatile ("add $4, %esp"); // leave syscall number
 	register word_t rcv_from asm ("eax");
 	if (from)
@@ -142,7 +200,7 @@ int l4_memory_control(word_t control, word_t attr0, word_t attr1, word_t attr2,
 }
 
 // do SystemClock syscall
-L4_clock_t l4_system_clock()
+static L4_clock_t system_clock_syscall()
 {
 	asm volatile ("push %0" :: "n"(L4_syscall_system_clock));
 	do_syscall();
@@ -152,6 +210,13 @@ L4_clock_t l4_system_clock()
 	return ((L4_clock_t)clock_hi << 32) | clock_lo;
 }
 
+// get SystemClock by kip clock data and cycle counter, syscall if it is not calibrated yet
+L4_clock_t l4_system_clock()
+{
+	L4_clock_t clock = l4_kip_get_clock_usec(l4_kip(), Proc::cycles);
+	return clock ? clock : system_clock_syscall();
+}
+
 // do ThreadSwitch syscall
 void l4_thread_switch(L4_thrid_t dest)
 {
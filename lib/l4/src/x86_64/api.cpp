@@ -7,17 +7,34 @@
 #include "l4_api.h"
 #include "l4_syscalls.h"
 #include "sys_utils.h"
+#include "sys_proc.h"
 
 struct App_data_t
 {
-	L4_kip_t* kip;  // also it is used as init flag
+	L4_kip_t* kip;         // also it is used as init flag
+	uint8_t   fast_scall;  // use syscall instead of int 0x80
 };
 
 static App_data_t app_data;
 
+// syscall clobbers rcx and r11:  pass them in r10 and r9, syscall number in r12
 __attribute__((always_inline)) inline void do_syscall()
 {
-	asm volatile ("int $0x80");
+	asm volatile
+	(
+		"cmpb $0, %0          \n"
+		"je 1f                \n"
+		"mov (%%rsp), %%r12   \n"  // syscall number
+		"mov %%rcx, %%r10     \n"
+		"mov %%r11, %%r9      \n"
+		"syscall              \n"
+		"mov %%r10, %%rcx     \n"
+		"jmp 2f               \n"
+		"1:                   \n"
+		"int $0x80            \n"
+		"2:                   \n"
+		:: "m"(app_data.fast_scall) : "r9", "r10", "r11", "r12", "memory", "cc"
+	);
 }
 
 // get pointer to Kernel Interface Page
@@ -53,9 +70,18 @@ L4_kip_t* l4_kip()
 	do_syscall();
 	asm volatile ("add $8, %rsp"); // leave syscall number
 	app_data.kip = (L4_kip_t*) rax;
+	app_data.fast_scall = app_data.kip->fast_scall;
 	return app_data.kip;
 }
 
+// select syscall entry, fast one is used by default if kernel supports it
+int l4_fast_syscall(int enable)
+{
+	int prev = app_data.fast_scall;
+	app_data.fast_scall = enable  &&  l4_kip()->fast_scall;
+	return prev;
+}
+
 // get pointer to UTCB
 L4_utcb_t* l4_utcb()
 {
@@ -90,6 +116,22 @@ int l4_ipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid
 	return l4_utcb()->msgtag().ipc_is_failed() ? l4_utcb()->ipc_error_code().error() : 0;
 }
 
+// do Lipc syscall, partners are in the same task
+int l4_lipc(L4_thrid_t to, L4_thrid_t from_spec, L4_timeouts_t timeouts, L4_thrid_t* from)
+{
+	register L4_thrid_t    rax asm ("rax") = to;
+	register L4_thrid_t    rdx asm ("rdx") = from_spec;
+	register L4_timeouts_t rcx asm ("rcx") = timeouts;
+	(void)rax; (void)rdx; (void)rcx;
+	asm volatile ("push %0" :: "n"(L4_syscall_lipc));
+	do_syscall();
+	asm volatile ("add $8, %rsp"); // leave syscall number
+	register word_t rcv_from asm ("rax");
+	if (from)
+		*from = rcv_from;
+	return l4_utcb()->msgtag().ipc_is_failed() ? l4_utcb()->ipc_error_code().error() : 0;
+}
+
 // send phase only
 int l4_send(L4_thrid_t to, L4_time_t timeout)
 {
@@ -160,7 +202,7 @@ int l4_memory_control(word_t control, word_t attr0, word_t attr1, word_t attr2,
 }
 
 // do SystemClock syscall
-L4_clock_t l4_system_clock()
+static L4_clock_t system_clock_syscall()
 {
 	asm volatile ("push %0" :: "n"(L4_syscall_system_clock));
 	do_syscall();
@@ -169,6 +211,13 @@ L4_clock_t l4_system_clock()
 	return clock;
 }
 
+// get SystemClock by kip clock data and cycle counter, syscall if it is not calibrated yet
+L4_clock_t l4_system_clock()
+{
+	L4_clock_t clock = l4_kip_get_clock_usec(l4_kip(), Proc::cycles);
+	return clock ? clock : system_clock_syscall();
+}
+
 // do ThreadSwitch syscall
 void l4_thread_switch(L4_thrid_t dest)
 {
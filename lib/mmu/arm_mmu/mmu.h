@@ -146,9 +146,24 @@ struct L2_map_t
 	};
 };
 
+// On SMP kernel mappings are shared by all CPUs, so invalidate TLB in the inner shareable domain,
+// hw broadcasts it to other CPUs and dsb waits for completion there (ARMv7 MP extensions).
 inline void mmu_tlb_flush()
 {
+	#if Cfg_krn_smp
+	asm volatile("mcr p15, 0, r0, c8, c3, 0;  dsb;  isb" ::: "memory"); // TLBIALLIS
+	#else
 	asm volatile("mcr p15, 0, r0, c8, c7, 0"); // TLBIALL
+	#endif
+}
+
+inline void mmu_tlb_flush_page(addr_t va)
+{
+	#if Cfg_krn_smp
+	asm volatile("mcr p15, 0, %0, c8, c3, 1;  dsb;  isb" :: "r"(va & ~0xfff) : "memory"); // TLBIMVAIS
+	#else
+	asm volatile("mcr p15, 0, %0, c8, c7, 1" :: "r"(va & ~0xfff)); // TLBIMVA
+	#endif
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -169,6 +184,14 @@ inline void mmu_set_dir(unsigned level, word_t* cell, paddr_t tb)
 	}
 }
 
+// is this table level supportes map records?
+inline bool mmu_has_map(unsigned level)
+{
+	mmu_assert(level == 1  ||  level == 2);
+	(void) level;
+	return true;  // L1 - 1 MB sections, L2 - 4 KB small pages
+}
+
 // make map record
 inline void _mmu_set_l1_map(word_t* cell, paddr_t pa, unsigned access, unsigned cachable)
 {
@@ -262,17 +285,22 @@ inline int mmu_get_map_cached(unsigned level, word_t* cell)
 }
 
 // get access attribute from map record
-inline const char* mmu_get_map_acc(unsigned level, word_t* cell)
+inline int mmu_get_map_access(unsigned level, word_t* cell)
 {
 	mmu_assert(level == 1  ||  level == 2);
 	mmu_assert((*cell & Et_mask) == Et_l1_map  ||  (*cell & Et_mask) == Et_l2_map);
-	int acc = 0;
 	if (level == 1)
-		acc = ((L1_map_t*)cell)->acc;
+		return ((L1_map_t*)cell)->acc;
 	else
 	if (level == 2)
-		acc = ((L2_map_t*)cell)->acc0;
-	switch (acc)
+		return ((L2_map_t*)cell)->acc0;
+	return -1;
+}
+
+// get access attribute name from map record
+inline const char* mmu_get_map_acc(unsigned level, word_t* cell)
+{
+	switch (mmu_get_map_access(level, cell))
 	{
 		case Mmu_acc_kno_uno:    return "k---_u---";
 		case Mmu_acc_krwx_uno:   return "krwx_u---";
@@ -111,6 +111,12 @@ inline void mmu_tlb_flush()
 	//Proc::sta(1, 0x400, Proc::Asi_flush_mmu_tlb);  // in HelenOS and Embox are used 0x400, why?
 }
 
+// flush type 0 in addr[11:8] - page flush in current context
+inline void mmu_tlb_flush_page(addr_t va)
+{
+	Proc::sta(0, va & ~0xfff, Proc::Asi_flush_mmu_tlb);
+}
+
 //--------------------------------------------------------------------------------------------------
 //  Table cells
 //--------------------------------------------------------------------------------------------------
@@ -124,6 +130,13 @@ inline void mmu_set_dir(unsigned level, word_t* cell, paddr_t tb)
 	*cell = ((tb >> 4) & ~(3)) | Et_ptd;
 }
 
+// is this table level supportes map records?
+inline bool mmu_has_map(unsigned level)
+{
+	(void)level;
+	return true;  // PTE may be at any level:  L1 - 16 MB, L2 - 256 KB, L3 - 4 KB
+}
+
 // make map record
 inline void mmu_set_map(unsigned level, word_t* cell, paddr_t pa, unsigned access, unsigned cachable)
 {
@@ -166,12 +179,17 @@ inline int mmu_get_map_cached(unsigned level, word_t* cell)
 }
 
 // get access attribute from map record
-inline const char* mmu_get_map_acc(unsigned level, word_t* cell)
+inline int mmu_get_map_access(unsigned level, word_t* cell)
 {
 	(void)level;
 	mmu_assert((*cell & Et_mask) == Et_pte);
-	int acc = (*cell >> 2) & Mmu_acc_mask;
-	switch (acc)
+	return (*cell >> 2) & Mmu_acc_mask;
+}
+
+// get access attribute name from map record
+inline const char* mmu_get_map_acc(unsigned level, word_t* cell)
+{
+	switch (mmu_get_map_access(level, cell))
 	{
 		case Mmu_acc_kro_uro:    return "kr--_ur--";
 		case Mmu_acc_krw_urw:    return "krw-_urw-";
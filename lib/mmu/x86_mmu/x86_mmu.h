@@ -440,6 +440,28 @@ inline void _mmu_set_pt_map(word_t* cell, paddr_t pa, unsigned access, unsigned
 //--------------------------------------------------------------------------------------------------
 //  API
 //--------------------------------------------------------------------------------------------------
+#ifdef X86_64
+inline bool mmu_is_1gb_page_supported()
+{
+	uint32_t a = 0x80000001, b, c = 0, d;
+	asm volatile ("cpuid" : "+a"(a), "=b"(b), "+c"(c), "=d"(d));
+	return d & (1 << 26);  // CPUID.80000001H:EDX.Page1GB
+}
+
+// cached mmu_is_1gb_page_supported(), false until mmu_init()
+inline bool& _mmu_1gb_pages()
+{
+	static bool supported;
+	return supported;
+}
+
+// read CPU features once, mmu_has_map() is called on every map
+inline void mmu_init()
+{
+	_mmu_1gb_pages() = mmu_is_1gb_page_supported();
+}
+#endif
+
 // is this table level supportes map records?
 inline addr_t mmu_has_map(unsigned level)
 {
@@ -460,7 +482,7 @@ inline addr_t mmu_has_map(unsigned level)
 		return 0;
 	else
 	if (level == 2)
-		return 1;  // TODO:  check PSE supporting
+		return _mmu_1gb_pages();
 	else
 	if (level == 3)
 		return 1;
@@ -619,7 +641,7 @@ inline int mmu_get_map_cached(unsigned level, word_t* cell)
 }
 
 // get access attribute from map record
-inline const char* mmu_get_map_acc(unsigned level, word_t* cell)
+inline int mmu_get_map_access(unsigned level, word_t* cell)
 {
 	#ifdef X86_32
 
@@ -645,7 +667,13 @@ inline const char* mmu_get_map_acc(unsigned level, word_t* cell)
 		acc = _mmu_make_acc(((PT_map_t*)cell)->user, ((PT_map_t*)cell)->writeable);
 
 	#endif
-	switch (acc)
+	return acc;
+}
+
+// get access attribute name from map record
+inline const char* mmu_get_map_acc(unsigned level, word_t* cell)
+{
+	switch (mmu_get_map_access(level, cell))
 	{
 		case Mmu_acc_krx_uno:    return "krx_uno";
 		case Mmu_acc_krwx_uno:   return "krwx_uno";
@@ -802,9 +830,69 @@ inline void mmu_root_table(word_t val)
 inline void mmu_tlb_flush()
 {
 	// NOTE:  don't need after mmu_root_table()
+	// NOTE:  with PCID it flushes entries of current PCID only
 	Proc::cr3(Proc::cr3());
 }
 
+// invalidate TLB entry of one page for current PCID
+inline void mmu_tlb_flush_page(addr_t va)
+{
+	asm volatile("invlpg (%0)" :: "r"(va) : "memory");
+}
+
+#ifdef X86_64
+
+// PCID:  process-context identifier in cr3[11:0] tags non-global TLB entries
+enum
+{
+	Mmu_pcid_max     = 0x1000,
+	Mmu_cr3_noflush  = 1ul << 63,  // don't flush TLB entries of new PCID at cr3 loading
+	Mmu_cr4_pcide    = 1 << 17,
+	Mmu_cr4_pge      = 1 << 7
+};
+
+inline bool mmu_is_pcid_supported()
+{
+	uint32_t a = 1, b, c = 0, d;
+	asm volatile ("cpuid" : "+a"(a), "=b"(b), "+c"(c), "=d"(d));
+	return c & (1 << 17);  // CPUID.01H:ECX.PCID
+}
+
+// cr3[11:0] must be 0
+inline void mmu_enable_pcid()
+{
+	Proc::cr4(Proc::cr4() | Mmu_cr4_pcide);
+}
+
+// allow global entries, they are not tagged by PCID and are kept at cr3 loading
+inline void mmu_enable_pge()
+{
+	Proc::cr4(Proc::cr4() | Mmu_cr4_pge);
+}
+
+// make map entry global, invlpg drops its TLB entry for all PCIDs
+inline void mmu_set_global(unsigned level, word_t* cell)
+{
+	mmu_assert(mmu_is_map(level, cell));
+	(void) level;
+	*cell |= 1 << 8;  // G bit of PDPT, PDT and PT map entries
+}
+
+inline void mmu_root_table(word_t val, unsigned pcid, bool noflush)
+{
+	Proc::cr3(val | pcid | (noflush ? (word_t)Mmu_cr3_noflush : 0));
+}
+
+// invalidate TLB entries of all PCIDs, including global
+inline void mmu_tlb_flush_all()
+{
+	word_t cr4 = Proc::cr4();
+	Proc::cr4(cr4 ^ Mmu_cr4_pge);
+	Proc::cr4(cr4);
+}
+
+#endif // X86_64
+
 inline void mmu_enable_pse()
 {
 	#ifdef X86_32
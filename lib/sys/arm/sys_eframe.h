@@ -146,9 +146,10 @@ public:
 	inline word_t scall_ipc_to()        const { return syscall_frame.r0; }
 	inline word_t scall_ipc_from_spec() const { return syscall_frame.r1; }
 	inline word_t scall_ipc_timeouts()  const { return syscall_frame.r2; }
+	inline word_t scall_ipc_from()      const { return syscall_frame.r0; }
 	inline void   scall_ipc_from(word_t v) { syscall_frame.r0 = v; }
 
-	// TODO:  lipc
+	// lipc uses the same registers as ipc
 
 	inline word_t scall_unmap_control()  const { return syscall_frame.r0; }
 
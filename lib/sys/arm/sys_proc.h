@@ -8,6 +8,7 @@
 #define SYS_PROC_H
 
 #include "sys_types.h"
+#include "sys-config.h"
 #include <stdio.h>
 
 class Proc
@@ -116,6 +117,43 @@ public:
 	static inline word_t mpidr() { word_t r; asm volatile ("mrc p15, 0, %0, c0, c0, 5": "=r"(r)); return r; }
 	static inline unsigned cpuid() { return  mpidr() & 0x3; }
 
+	// index of most significant set bit, v must be non-zero
+	static inline unsigned msb(uint32_t v) { uint32_t r; asm ("clz %0, %1" : "=r"(r) : "r"(v)); return 31 - r; }
+
+	#if defined(Cfg_cpu_arm11)
+
+	// cycle counter of arm11 system control coprocessor, it isn't readable from user mode,
+	// user gets 0 - no counter
+	static inline uint64_t cycles()
+	{
+		if ((cpsr() & 0x1f) == Usr)
+			return 0;
+		word_t r;
+		asm volatile ("mrc p15, 0, %0, c15, c12, 1" : "=r"(r));
+		return r;
+	}
+
+	// start cycle counter:  PMNC.E and PMNC.C (reset)
+	static inline void cycles_init() { asm volatile ("mcr p15, 0, %0, c15, c12, 0" :: "r"(0x5)); }
+
+	#else
+
+	// PMU cycle counter, 32 bit, it counts if PMCR.E and PMCNTENSET.C are set
+	static inline uint64_t cycles() { word_t r; asm volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r"(r)); return r; }
+
+	// start cycle counter without divider and allow user mode to read it
+	static inline void cycles_init()
+	{
+		word_t pmcr;
+		asm volatile ("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));             // PMCR
+		pmcr = (pmcr & ~0x8) | 0x5;                                          // D=0, C=1 (reset), E=1
+		asm volatile ("mcr p15, 0, %0, c9, c12, 0" :: "r"(pmcr));
+		asm volatile ("mcr p15, 0, %0, c9, c12, 1" :: "r"(1 << 31));         // PMCNTENSET.C
+		asm volatile ("mcr p15, 0, %0, c9, c14, 0" :: "r"(1));               // PMUSERENR.EN
+	}
+
+	#endif
+
 	static inline void rmb()        { asm volatile ("dsb" ::: "memory"); }
 	static inline void wmb()        { asm volatile ("dsb" ::: "memory"); }
 	static inline void mb()         { asm volatile ("dsb" ::: "memory"); }
@@ -93,6 +93,21 @@ public:
 	static inline unsigned cpuid() { return 0; }
 	#endif
 
+	// index of most significant set bit, v must be non-zero;
+	// SPARC v8 has no bit-scan instruction, use shifts and nibble table
+	static inline unsigned msb(uint32_t v)
+	{
+		static const uint8_t nibble_msb[16] = { 0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 };
+		unsigned r = 0;
+		if (v >> 16) { v >>= 16;  r += 16; }
+		if (v >> 8)  { v >>= 8;   r += 8;  }
+		if (v >> 4)  { v >>= 4;   r += 4;  }
+		return r + nibble_msb[v];
+	}
+
+	// no cycle counter
+	static inline uint64_t cycles() { return 0; }
+
 	static inline void rmb()        { asm volatile ("" ::: "memory"); }
 	static inline void wmb()        { asm volatile ("" ::: "memory"); }
 	static inline void wait_event() { asm volatile ("" ::: "memory"); }
@@ -44,7 +44,7 @@ public:
 	word_t rax;
 
 	// stored by hw
-	word_t err;   // exception error, for SW traps and IRQ set 0, see crt0.S
+	word_t err;   // exception error, for SW traps and IRQ set 0, syscall number for fast entry
 	word_t rip;
 	word_t cs;
 	word_t rflags;
@@ -122,7 +122,11 @@ public:
 	inline uint16_t dx()       { return syscall_frame.rdx & 0xffff; }
 	inline word_t error()      { return syscall_frame.err; }
 
-	inline unsigned scall_number() { return *(word_t*)(syscall_frame.rsp); } // on user stack
+	// fast entry stores syscall number instead of error code, int 0x80 leaves it on user stack
+	inline unsigned scall_number()
+	{
+		return syscall_frame.err ? syscall_frame.err : *(word_t*)(syscall_frame.rsp);
+	}
 
 	inline void scall_kip_base_addr(word_t v)   { syscall_frame.rax = v; }
 	inline void scall_kip_api_version(word_t v) { syscall_frame.rcx = v; }
@@ -168,9 +172,10 @@ public:
 	inline word_t scall_ipc_to()        const { return syscall_frame.rax; }
 	inline word_t scall_ipc_from_spec() const { return syscall_frame.rdx; }
 	inline word_t scall_ipc_timeouts()  const { return syscall_frame.rcx; }
+	inline word_t scall_ipc_from()      const { return syscall_frame.rax; }
 	inline void   scall_ipc_from(word_t v) { syscall_frame.rax = v; }
 
-	// TODO:  lipc
+	// lipc uses the same registers as ipc
 
 	inline word_t scall_unmap_control()  const { return syscall_frame.rax; }
 
@@ -95,6 +95,18 @@ public:
 
 	static inline unsigned cpuid() { return 0; }                           // FIXME:  IMPLME
 
+	// index of most significant set bit, v must be non-zero
+	static inline unsigned msb(uint32_t v) { uint32_t r; asm ("bsr %1, %0" : "=r"(r) : "rm"(v)); return r; }
+
+	// free running CPU cycle counter
+	static inline uint64_t cycles()
+	{
+		uint32_t lo;
+		uint32_t hi;
+		asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+		return ((uint64_t)hi << 32) | lo;
+	}
+
 	static inline void rmb()        { asm volatile ("" ::: "memory"); }    // FIXME:  IMPLME
 	static inline void wmb()        { asm volatile ("" ::: "memory"); }    // FIXME:  IMPLME
 	static inline void wait_event() { asm volatile ("" ::: "memory"); }    // FIXME:  IMPLME
@@ -49,6 +49,20 @@ inline void timer_init(unsigned long base_addr, Timer_print_t dprint)
 	regs->control = 0;
 }
 
+inline uint64_t timer_raw_value(unsigned long base_addr)
+{
+	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
+	uint32_t hi = regs->counter_hi;
+	uint32_t lo = regs->counter_lo;
+	if (hi != regs->counter_hi)
+	{
+		// hi was updated, re-read
+		hi = regs->counter_hi;
+		lo = regs->counter_lo;
+	}
+	return ((uint64_t)hi << 32) | lo;
+}
+
 inline int timer_set(unsigned long base_addr, unsigned sysclock_hz, unsigned period_usec)
 {
 	sysclock_hz /= 2;  // PERIPHCLK
@@ -57,18 +71,55 @@ inline int timer_set(unsigned long base_addr, unsigned sysclock_hz, unsigned per
 	if (value > 0xffffffff)
 		return 1;  // too big period, this driver implementation support only 32-bit counter
 
+	// counter isn't reset, it is free-running time base, see timer_counter()
 	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
-	regs->control       = 0;           // disable timer
-	regs->counter_lo    = 0;           //
-	regs->counter_hi    = 0;           //
+	regs->control      &= Ctrl_tmr_en; // disable comparison and irq
 	regs->istatus       = Stat_event;  // write to clear
-	regs->comparator_lo = value;       // note:  first interval will be more by 1 than period
-	regs->comparator_hi = 0;           //
+	uint64_t comp = timer_raw_value(base_addr) + value;
+	regs->comparator_lo = comp;        // note:  first interval will be more by 1 than period
+	regs->comparator_hi = comp >> 32;  //
 	regs->auto_inc      = value;       // don't need -1, it is period
 
 	return 0;
 }
 
+// max period which may be set by timer_set()
+inline unsigned timer_max_period_usec(unsigned long base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	sysclock_hz /= 2;  // PERIPHCLK
+	enum { Usec_per_sec = 1000*1000 };
+	uint64_t max_usec = (uint64_t)0xffffffff * Usec_per_sec / sysclock_hz;
+	return max_usec > 0xffffffff  ?  0xffffffff  :  max_usec;
+}
+
+// free-running counter for time base is the global timer counter, timer_set() doesn't reset it
+inline int timer_counter_start(unsigned long base_addr, unsigned sysclock_hz)
+{
+	(void) sysclock_hz;
+	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
+	regs->control |= Ctrl_tmr_en;
+	return 0;
+}
+
+// incremented value of free-running counter, wraps at timer_counter_mask()
+inline uint64_t timer_counter(unsigned long base_addr)
+{
+	return timer_raw_value(base_addr);
+}
+
+inline uint64_t timer_counter_mask(unsigned long base_addr)
+{
+	(void) base_addr;
+	return ~(uint64_t)0;
+}
+
+inline unsigned timer_counter_hz(unsigned long base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	return sysclock_hz / 2;  // PERIPHCLK
+}
+
 inline void timer_start(unsigned long base_addr)
 {
 	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
@@ -110,27 +161,16 @@ inline uint64_t timer_usec_from_raw_value(unsigned long base_addr, unsigned sysc
 		remain_usec -= reload_usec;
 	return reload_usec - remain_usec;
 #else
+	// comparator is incremented by reload every event, so time since last event is
+	// (counter - comparator) mod reload, counter may be not aligned to reload
 	uint32_t reload_reg = regs->auto_inc;
-	uint64_t mod = value_reg % reload_reg;
+	uint64_t comp_mod = _timer_comparator(base_addr) % reload_reg;
+	uint64_t mod = (value_reg % reload_reg + reload_reg - comp_mod) % reload_reg;
 	uint64_t mod_usec = mod * Usec_per_sec / sysclock_hz;
 	return mod_usec;
 #endif
 }
 
-inline uint64_t timer_raw_value(unsigned long base_addr)
-{
-	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
-	uint32_t hi = regs->counter_hi;
-	uint32_t lo = regs->counter_lo;
-	if (hi != regs->counter_hi)
-	{
-		// hi was updated, re-read
-		hi = regs->counter_hi;
-		lo = regs->counter_lo;
-	}
-	return ((uint64_t)hi << 32) | lo;
-}
-
 // return timer value MOD reload_usec
 inline uint64_t timer_value_usec(unsigned long base_addr, unsigned sysclock_hz, unsigned reload_usec)
 {
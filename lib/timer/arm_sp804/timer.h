@@ -55,7 +55,8 @@ enum
 	Control_size        =  1,   // (0) 16-bit counter, (1) 32-bit counter
 	Control_oneshot     =  0,   // (0) wrapping mode, (1) one-shot mode
 
-	Ktmr = 0,
+	Ktmr = 0,               // periodic timer for kernel irq
+	Ctmr = 1,               // free-running counter for time base
 };
 
 typedef void (*Timer_print_t)(const char* format, ...) __attribute__((format(printf, 1, 2)));
@@ -115,6 +116,49 @@ inline int timer_set(unsigned base_addr, unsigned sysclock_hz, unsigned period_u
 	return 0;
 }
 
+// max period which may be set by timer_set()
+inline unsigned timer_max_period_usec(unsigned base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	enum { Pre_max_div = 256, Usec_per_sec = 1000*1000 };
+	uint64_t max_usec = (uint64_t)0xffffffff * Pre_max_div / sysclock_hz * Usec_per_sec;
+	return max_usec > 0xffffffff  ?  0xffffffff  :  max_usec;
+}
+
+// free-running counter for time base, it isn't reset by timer_set()
+inline int timer_counter_start(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	(void) sysclock_hz;
+	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
+	regs->tmr[Ctmr].load = 0xffffffff;
+	regs->tmr[Ctmr].control = (1   << Control_en)   |    // enable timer
+	                          (0   << Control_mode) |    // free-running mode
+	                          (0   << Control_int)  |    // disable interrupt
+	                          (0   << Control_pre)  |    // prescale (0)->1
+	                          (1   << Control_size) |    // 32-bit
+	                          (0   << Control_oneshot);  // wrapping mode
+	return 0;
+}
+
+// incremented value of free-running counter, wraps at timer_counter_mask()
+inline uint64_t timer_counter(uintptr_t base_addr)
+{
+	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
+	return 0xffffffff - regs->tmr[Ctmr].value;  // counts down
+}
+
+inline uint64_t timer_counter_mask(uintptr_t base_addr)
+{
+	(void) base_addr;
+	return 0xffffffff;
+}
+
+inline unsigned timer_counter_hz(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	return sysclock_hz;
+}
+
 inline void timer_start(unsigned base_addr)
 {
 	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
@@ -57,6 +57,7 @@ enum
 	Control_en          =  1 << 0,  // enable the timer
 
 	Ktmr                =  0,       // number of timer for kernel purpose
+	Ctmr                =  1,       // number of timer for free-running counter
 };
 
 typedef void (*Timer_print_t)(const char* format, ...) __attribute__((format(printf, 1, 2)));
@@ -94,14 +95,65 @@ inline int timer_set(uintptr_t base_addr, unsigned sysclock_hz, unsigned period_
 	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
 	unsigned ticks = period_usec;
 	unsigned scaler = sysclock_hz / Usec_per_sec; // preload 1 usec
-	regs->scaler = scaler - 1;
-	regs->scaler_reload = scaler - 1;
+	if (regs->scaler_reload != scaler - 1)
+	{
+		// scaler is shared with free-running counter, don't restart it without need
+		regs->scaler = scaler - 1;
+		regs->scaler_reload = scaler - 1;
+	}
 	regs->timer[Ktmr].counter = ticks - 1;
 	regs->timer[Ktmr].reload = ticks - 1;
 	regs->timer[Ktmr].control = Control_ip;  // clear InterruptPending bit
 	return 0;
 }
 
+// max period which may be set by timer_set(), counter is decremented every usec
+inline unsigned timer_max_period_usec(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	(void) sysclock_hz;
+	return 0xffffffff;
+}
+
+// free-running counter for time base, it isn't reset by timer_set(), counts usec
+inline int timer_counter_start(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	enum { Usec_per_sec = 1000*1000 };
+	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
+	if (num_timers(base_addr) <= Ctmr)
+		return 1;
+	unsigned scaler = sysclock_hz / Usec_per_sec; // preload 1 usec
+	if (regs->scaler_reload != scaler - 1)
+	{
+		regs->scaler = scaler - 1;
+		regs->scaler_reload = scaler - 1;
+	}
+	regs->timer[Ctmr].counter = 0xffffffff;
+	regs->timer[Ctmr].reload = 0xffffffff;
+	regs->timer[Ctmr].control = Control_en | Control_rs | Control_ld;
+	return 0;
+}
+
+// incremented value of free-running counter, wraps at timer_counter_mask()
+inline uint64_t timer_counter(uintptr_t base_addr)
+{
+	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
+	return 0xffffffff - regs->timer[Ctmr].counter;  // counts down
+}
+
+inline uint64_t timer_counter_mask(uintptr_t base_addr)
+{
+	(void) base_addr;
+	return 0xffffffff;
+}
+
+inline unsigned timer_counter_hz(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	(void) sysclock_hz;
+	return 1000*1000;  // scaler gives 1 usec
+}
+
 inline void timer_start(uintptr_t base_addr)
 {
 	volatile Timer_regs_t* regs = (Timer_regs_t*) base_addr;
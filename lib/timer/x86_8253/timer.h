@@ -25,6 +25,10 @@ enum
 	Timer_io_ch1  = 0x41,  // channel 1 data port (read/write), used for DMA
 	Timer_io_ch2  = 0x42,  // channel 2 data port (read/write), used for PC speaker
 	Timer_io_ctrl = 0x43,  // Mode/Command register (write only, a read is ignored)
+	Timer_io_gate = 0x61,  // bit 0 - gate of channel 2, bit 1 - PC speaker enable
+
+	Gate_ch2_en   = 1 << 0,
+	Gate_spkr_en  = 1 << 1,
 
 	Ctrl_offset_counter  = 6,
 	Ctrl_offset_rw       = 4,
@@ -91,6 +95,51 @@ inline int timer_set(uintptr_t base_addr, unsigned sysclock_hz, unsigned period_
 	return 0;
 }
 
+// max period which may be set by timer_set()
+inline unsigned timer_max_period_usec(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	(void) sysclock_hz;
+	return (uint64_t)0xffff * Usec_per_sec / Sys_clock_hz;
+}
+
+// free-running counter for time base, it isn't reset by timer_set():  channel 2 with max
+// reload value, speaker output is disabled
+inline int timer_counter_start(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	if (sysclock_hz != Sys_clock_hz)
+		return 1;
+	Proc::outb(Timer_io_gate, (Proc::inb(Timer_io_gate) & ~Gate_spkr_en) | Gate_ch2_en);
+	Proc::outb(Timer_io_ctrl, _timer_ctrl(Ctrl_cntr2, Ctrl_rw_lsb_then_msb, Ctrl_mode_rate_gen));
+	Proc::outb(Timer_io_ch2, 0);  // 0 means 0x10000
+	Proc::outb(Timer_io_ch2, 0);
+	return 0;
+}
+
+// incremented value of free-running counter, wraps at timer_counter_mask()
+inline uint64_t timer_counter(uintptr_t base_addr)
+{
+	(void) base_addr;
+	Proc::outb(Timer_io_ctrl, _timer_ctrl(Ctrl_cntr2, Ctrl_rw_latch, 0));
+	uint8_t lsb = Proc::inb(Timer_io_ch2);
+	uint8_t msb = Proc::inb(Timer_io_ch2);
+	return (uint16_t)(0 - (((uint16_t)msb << 8) | lsb));  // counts down
+}
+
+inline uint64_t timer_counter_mask(uintptr_t base_addr)
+{
+	(void) base_addr;
+	return 0xffff;
+}
+
+inline unsigned timer_counter_hz(uintptr_t base_addr, unsigned sysclock_hz)
+{
+	(void) base_addr;
+	(void) sysclock_hz;
+	return Sys_clock_hz;
+}
+
 inline void timer_start(uintptr_t base_addr)
 {
 	(void) base_addr;
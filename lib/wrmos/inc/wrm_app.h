@@ -16,6 +16,7 @@ extern "C" {
 int wrm_app_create(L4_thrid_t id, const Wrm_app_cfg_t* cfg);
 int wrm_app_add_location(L4_thrid_t id, addr_t rem_va, L4_fpage_t location);
 int wrm_app_get_location(L4_thrid_t id, addr_t rem_va, size_t sz, acc_t acc, L4_fpage_t* loc_fpage);
+int wrm_app_get_pfault_location(L4_thrid_t id, addr_t rem_va, acc_t acc, L4_fpage_t* loc_fpage);
 int wrm_app_alloc_aspace(L4_thrid_t id);
 int wrm_app_free_aspace(L4_thrid_t id);
 int wrm_app_max_prio(L4_thrid_t id, unsigned* max_prio);
@@ -8,12 +8,14 @@
 #define WRM_APP_USER_H
 
 #include "l4_types.h"
+#include "l4_kdbops.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 int wrm_app_threads(L4_thrid_t app, unsigned* thrno_begin, unsigned* thrno_end);
+int wrm_kprof(unsigned op, L4_kprof_sample_t* buf, unsigned cnt);
 
 #ifdef __cplusplus
 }
@@ -16,7 +16,8 @@ extern "C" {
 int wrm_dev_map_io(const char* dev_name, addr_t* addr, size_t* sz = 0);
 int wrm_dev_attach_int(const char* dev_name, unsigned* intno);
 int wrm_dev_detach_int(const char* dev_name);
-int wrm_dev_wait_int(unsigned intno, unsigned flags);
+int wrm_dev_wait_int(unsigned intno, unsigned flags = 0, unsigned* events = 0);
+int wrm_dev_coalesce_int(unsigned intno, unsigned usec, unsigned events);
 
 #ifdef __cplusplus
 }
@@ -20,7 +20,8 @@ enum
 	Wrm_ipc_create_task      =  8,
 	Wrm_ipc_register_thread  =  9,
 	Wrm_ipc_get_thread_id    = 10,
-	Wrm_ipc_app_threads      = 11
+	Wrm_ipc_app_threads      = 11,
+	Wrm_ipc_kprof            = 12
 };
 
 #endif // WRM_LABELS
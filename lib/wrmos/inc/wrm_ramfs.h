@@ -15,6 +15,12 @@ extern "C" {
 
 int wrm_ramfs_get_file(const char* filename, addr_t* addr, size_t* size);
 
+// physical area of ramfs, it is accessible for roottask only
+int wrm_ramfs_area(addr_t* addr, size_t* size);
+
+// use copy of ramfs instead of original, e.g. mapped by named memory 'ramfs'
+int wrm_ramfs_attach(addr_t copy_addr, size_t copy_size);
+
 #ifdef __cplusplus
 }
 #endif
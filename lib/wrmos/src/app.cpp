@@ -127,6 +127,11 @@ public:
 
 class App_t
 {
+	enum
+	{
+		Fpage_sz_max = 0x400000  // the largest superpage of supported MMUs (x86 PSE)
+	};
+
 	struct region_t
 	{
 		addr_t remote;         // vaddr in remote aspace
@@ -360,11 +365,29 @@ public:
 		return new_reg;
 	}
 
+	// the largest naturally aligned block around rem_va that lies inside region and has the same
+	// alignment in local aspace, it may be mapped by one fpage and one superpage
+	size_t block_size(regions_t::iter_t reg, addr_t rem_va, size_t sz_max)
+	{
+		size_t res = Cfg_page_sz;
+		for (size_t s=2*Cfg_page_sz; s<=sz_max; s*=2)
+		{
+			addr_t va = round_down(rem_va, s);
+			if (va < reg->remote  ||  va + s > reg->remote_end())
+				break;
+			if (reg->location()  &&  !is_aligned(reg->location() + (va - reg->remote), s))
+				break;
+			res = s;
+		}
+		return res;
+	}
+
 public:
 
 	// find local_va for remote_va
 	// allocate memory from pool if need
-	addr_t get_location(addr_t rem_va, addr_t sz, acc_t acc, acc_t* acc_max = 0)
+	// if fpage_sz is set, allocate and return the largest block around rem_va to map it at once
+	addr_t get_location(addr_t rem_va, addr_t sz, acc_t acc, acc_t* acc_max = 0, size_t* fpage_sz = 0)
 	{
 		//wrm_logd("%s:  req:  0x%lx - 0x%lx, sz=0x%lx, acc=%d.\n",
 		//	__func__, rem_va, rem_va + sz, sz, acc);
@@ -383,15 +406,31 @@ public:
 					wrm_loge("%s:  Malloc_on_startup but no location.\n", __func__);
 				*/
 
-				// split to smaller regions if need
-				if (sz < reg->sz)
-					reg = split_to_smaller_regions(reg, rem_va, sz);
+				// try to allocate the largest block, pool may have no such free block
+				L4_fpage_t fp = L4_fpage_t::create_nil();
+				for (size_t s = fpage_sz ? block_size(reg, rem_va, Fpage_sz_max) : 0; s > Cfg_page_sz; s /= 2)
+				{
+					fp = wrm_pgpool_alloc(s);
+					if (!fp.is_nil())
+					{
+						if (s < reg->sz)
+							reg = split_to_smaller_regions(reg, round_down(rem_va, s), s);
+						break;
+					}
+				}
 
-				// allocate
-				L4_fpage_t fp = wrm_pgpool_alloc(round_pg_up(reg->sz));
-				assert(!fp.is_nil());
 				if (fp.is_nil())
-					return 0;
+				{
+					// split to smaller regions if need
+					if (sz < reg->sz)
+						reg = split_to_smaller_regions(reg, rem_va, sz);
+
+					// allocate
+					fp = wrm_pgpool_alloc(round_pg_up(reg->sz));
+					assert(!fp.is_nil());
+					if (fp.is_nil())
+						return 0;
+				}
 
 				// FIXME:  allocated page may cross several regions, but reg->local set only for one
 				reg->local = fp.addr();
@@ -408,6 +447,8 @@ public:
 
 			if (acc_max)
 				*acc_max = reg->acc;
+			if (fpage_sz)
+				*fpage_sz = block_size(reg, rem_va, Fpage_sz_max);
 
 			size_t offset = rem_va - reg->remote;
 			assert(reg->location());
@@ -811,7 +852,8 @@ extern "C" int wrm_app_add_location(L4_thrid_t id, addr_t rem_va, L4_fpage_t loc
 	return 0;
 }
 
-extern "C" int wrm_app_get_location(L4_thrid_t id, addr_t rem_addr, size_t sz, acc_t acc, L4_fpage_t* loc_fpage)
+static int get_location(L4_thrid_t id, addr_t rem_addr, size_t sz, acc_t acc, L4_fpage_t* loc_fpage,
+                        bool large)
 {
 	App_t* app = apps.find(id);
 	if (!app)
@@ -821,13 +863,15 @@ extern "C" int wrm_app_get_location(L4_thrid_t id, addr_t rem_addr, size_t sz, a
 		return -1;
 	}
 	acc_t acc_max = 0;
-	addr_t local_addr = app->get_location(rem_addr, sz, acc, &acc_max);
+	size_t fpage_sz = 0;
+	size_t* pfpage_sz = large ? &fpage_sz : 0;
+	addr_t local_addr = app->get_location(rem_addr, sz, acc, &acc_max, pfpage_sz);
 	if (!local_addr)
 	{
 		//wrm_logw("app=%.4s:  location for remote va=0x%x for acc=%u does not found, thr=%u.\n",
 		//	app->name_str(), rem_addr, acc, id.number());
 		// try to find without acc for debug
-		local_addr = app->get_location(rem_addr, sz, Acc_nil, &acc_max);
+		local_addr = app->get_location(rem_addr, sz, Acc_nil, &acc_max, pfpage_sz);
 		//wrm_logw("result for addr without acc:  local_addr=0x%lx, acc_max=%d.\n", local_addr, acc_max);
 
 		// FIXME:  WA for w4linux - allow map with increasing of access rights
@@ -844,7 +888,10 @@ extern "C" int wrm_app_get_location(L4_thrid_t id, addr_t rem_addr, size_t sz, a
 		}
 	}
 	//wrm_logi("found local page:  addr=0x%x, acc=%u, acc_max=%u.\n", local_addr, acc, acc_max);
-	*loc_fpage = L4_fpage_t::create(round_pg_down(local_addr), round_pg_up(sz), acc_max);
+	if (fpage_sz > round_pg_up(sz))
+		*loc_fpage = L4_fpage_t::create(round_down(local_addr, fpage_sz), fpage_sz, acc_max);
+	else
+		*loc_fpage = L4_fpage_t::create(round_pg_down(local_addr), round_pg_up(sz), acc_max);
 	if (loc_fpage->is_nil())
 	{
 		wrm_loge("faild to do fpage, something going wrong.\n");
@@ -853,6 +900,17 @@ extern "C" int wrm_app_get_location(L4_thrid_t id, addr_t rem_addr, size_t sz, a
 	return 0;
 }
 
+extern "C" int wrm_app_get_location(L4_thrid_t id, addr_t rem_addr, size_t sz, acc_t acc, L4_fpage_t* loc_fpage)
+{
+	return get_location(id, rem_addr, sz, acc, loc_fpage, false);
+}
+
+// returns the largest fpage around rem_addr, the fpage is mapped to size aligned block of remote aspace
+extern "C" int wrm_app_get_pfault_location(L4_thrid_t id, addr_t rem_addr, acc_t acc, L4_fpage_t* loc_fpage)
+{
+	return get_location(id, rem_addr, sizeof(word_t), acc, loc_fpage, true);
+}
+
 extern "C" int wrm_app_alloc_aspace(L4_thrid_t id)
 {
 	App_t* app = apps.find(id);
@@ -62,3 +62,49 @@ int wrm_app_threads(L4_thrid_t app_id, unsigned* thrno_begin, unsigned* thrno_en
 	*thrno_end = utcb->mr[3];
 	return 0;
 }
+
+// kdb kprof syscall is allowed for roottask only, send kprof request to alpha;
+// return number of samples for L4_kprof_read, 0 for other ops and negative value on error
+int wrm_kprof(unsigned op, L4_kprof_sample_t* buf, unsigned cnt)
+{
+	L4_utcb_t* utcb = l4_utcb();
+	L4_msgtag_t tag;
+	tag.ipc_label(Wrm_ipc_kprof);
+	tag.propagated(false);
+	tag.untyped(2);
+	tag.typed(0);
+	utcb->mr[0] = tag.raw();
+	utcb->mr[1] = op;
+	utcb->mr[2] = buf ? cnt : 0;
+
+	// samples come as string to buf
+	bool rcv_str = op == L4_kprof_read  &&  buf  &&  cnt;
+	utcb->acceptor(L4_acceptor_t(L4_fpage_t::create_nil(), rcv_str));
+	if (rcv_str)
+	{
+		L4_string_item_t bitem = L4_string_item_t::create_simple((word_t)buf, cnt * sizeof(L4_kprof_sample_t));
+		utcb->br[1] = bitem.word0();
+		utcb->br[2] = bitem.word1();
+	}
+
+	L4_thrid_t from = L4_thrid_t::Nil;
+	L4_time_t never(L4_time_t::Never);
+	const L4_thrid_t alpha = l4_thrid_roottask();
+	int rc = l4_ipc(alpha, alpha, L4_timeouts_t(never, never), &from);
+	if (rc)
+	{
+		wrm_loge("%s:  l4_ipc(alpha) failed, rc=%u.\n", __func__, rc);
+		return -2;
+	}
+
+	assert(from == alpha);
+
+	tag = utcb->msgtag();
+	if (tag.ipc_label() != Wrm_ipc_kprof  ||  tag.untyped() != 1)
+	{
+		wrm_loge("%s:  Wrm_ipc_kprof wrong reply format:  lbl_ok=%d, t=%u, u=%u.\n",
+			__func__, tag.ipc_label()==Wrm_ipc_kprof, tag.typed(), tag.untyped());
+		return -3;
+	}
+	return (int)utcb->mr[1];
+}
@@ -211,8 +211,8 @@ extern "C" int wrm_dev_detach_int(const char* dev_name)
 	return send_attach_detach_request(dev_name, &unused, Wrm_ipc_detach_int);
 }
 
-// send re-enable msg and wait new interrupt
-extern "C" int wrm_dev_wait_int(unsigned intno, unsigned flags)
+// send re-enable msg and wait new interrupt, 'events' gets number of coalesced interrupts
+extern "C" int wrm_dev_wait_int(unsigned intno, unsigned flags, unsigned* events)
 {
 	L4_utcb_t* utcb = l4_utcb();
 	L4_msgtag_t tag;
@@ -221,5 +221,26 @@ extern "C" int wrm_dev_wait_int(unsigned intno, unsigned flags)
 	utcb->mr[1] = flags;
 	L4_thrid_t from = L4_thrid_t::Nil;
 	L4_thrid_t int_id = L4_thrid_t::create_irq(intno);
-	return l4_ipc(int_id, int_id, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never), &from);
+	int rc = l4_ipc(int_id, int_id, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never), &from);
+	if (!rc  &&  events)
+		*events = utcb->msgtag().untyped() ? utcb->mr[1] : 1;
+	return rc;
+}
+
+// wrm extention:  coalesce interrupts of high-rate device
+//   events <= 1 - no more than one notification per 'usec', irq stays masked after ack;
+//   events > 1  - for edge irqs, notification per 'events' interrupts or 'usec' after the first.
+// usec=0 turns coalescing off. Kernel checks holds on timer tick.
+extern "C" int wrm_dev_coalesce_int(unsigned intno, unsigned usec, unsigned events)
+{
+	L4_utcb_t* utcb = l4_utcb();
+	L4_msgtag_t tag;
+	tag.set_ipc(0, 3, 0);
+	utcb->mr[0] = tag.raw();
+	utcb->mr[1] = 0;
+	utcb->mr[2] = usec;
+	utcb->mr[3] = events;
+	L4_thrid_t from = L4_thrid_t::Nil;
+	L4_thrid_t int_id = L4_thrid_t::create_irq(intno);
+	return l4_ipc(int_id, L4_thrid_t::Nil, L4_timeouts_t(L4_time_t::Never, L4_time_t::Never), &from);
 }
@@ -14,6 +14,7 @@ struct Ramfs_t
 {
 	addr_t addr;
 	size_t sz;
+	addr_t diff;  // pointers in file headers are physical, diff = va - pa for copy of ramfs
 };
 static Ramfs_t _ramfs;
 
@@ -36,6 +37,36 @@ static void find_ramfs()
 	}
 	_ramfs.addr = adr;
 	_ramfs.sz = sz;
+	_ramfs.diff = 0;
+}
+
+extern "C" int wrm_ramfs_area(addr_t* addr, size_t* size)
+{
+	if (!_ramfs.sz)
+		find_ramfs();
+
+	if (!_ramfs.sz)
+		return -1;  // no ramfs found
+
+	*addr = _ramfs.addr - _ramfs.diff;
+	*size = _ramfs.sz;
+	return 0;
+}
+
+extern "C" int wrm_ramfs_attach(addr_t copy_addr, size_t copy_size)
+{
+	addr_t pa = 0;
+	size_t sz = 0;
+	int rc = wrm_ramfs_area(&pa, &sz);
+	if (rc)
+		return rc;
+
+	if (copy_size < sz)
+		return -2;  // copy is too small
+
+	_ramfs.addr = copy_addr;
+	_ramfs.diff = copy_addr - pa;
+	return 0;
 }
 
 extern "C" int wrm_ramfs_get_file(const char* filename, addr_t* addr, size_t* size)
@@ -49,10 +80,10 @@ extern "C" int wrm_ramfs_get_file(const char* filename, addr_t* addr, size_t* si
 	Ramfs_file_header_t* file = (Ramfs_file_header_t*) _ramfs.addr;
 	do
 	{
-		if (!strcmp(file->name, filename))
+		if (!strcmp(file->name + _ramfs.diff, filename))
 		{
 			if (addr)
-				*addr = (addr_t) file->data;
+				*addr = (addr_t) file->data + _ramfs.diff;
 			if (size)
 				*size = file->size;
 			return 0;
@@ -46,12 +46,13 @@ static void resume(L4_thrid_t thr)
 	tag.ipc_label(0x202); // 0x202 - sw irq trigger
 	utcb->msgtag(tag);
 
-	int rc = l4_send(thr, L4_time_t::Zero);
+	// waiters are threads of this task, local IPC wakes them without generic IPC path
+	int rc = l4_lipc(thr, L4_thrid_t::Nil, L4_timeouts_t(L4_time_t::Zero, L4_time_t::Never));
 
 	if (rc)
 	{
 		wrm_loge("sem:  resume:  sent ipc (sw irq), rc=%d, to=0x%lx/%u.\n", rc, thr.raw(), thr.number());
-		assert(0 && "l4_send() failed.");
+		assert(0 && "l4_lipc() failed.");
 	}
 
 	utcb->msgtag(L4_msgtag_t()); // to avoid wrong 'sw irq trigger' // DELME
@@ -68,6 +68,16 @@ $(cfgdir)/krn-config.h:  $(cfg_deps)
 	#define Cfg_krn_timer_sz $(krn_timer_sz)\n\
 	#define Cfg_krn_timer_irq $(krn_timer_irq)\n\
 	#define Cfg_krn_timer_lag_usec $(krn_timer_lag_usec)\n\
+	#define Cfg_krn_tickless $(krn_tickless)\n\
+	#define Cfg_krn_smp $(krn_smp)\n\
+	#define Cfg_krn_fastipc $(krn_fastipc)\n\
+	#define Cfg_krn_fastscall $(krn_fastscall)\n\
+	#define Cfg_krn_tlbtags $(krn_tlbtags)\n\
+	#define Cfg_krn_thrbits $(krn_thrbits)\n\
+	#define Cfg_krn_kmempages $(krn_kmempages)\n\
+	#define Cfg_krn_ktrace $(krn_ktrace)\n\
+	#define Cfg_krn_kprof $(krn_kprof)\n\
+	#define Cfg_krn_ipcstat $(krn_ipcstat)\n\
 	\n\
 	#endif // KRN_CONFIG_H" > $@
 